@@ -108,6 +108,7 @@ static const char * const opts_nosuggest[] =
     "--crop-rect",
     "--deadzone-inter",
     "--deadzone-intra",
+    "--fast-decision",
     "--fps",
     "--frames",
     "--input-depth",
@@ -144,6 +145,9 @@ static const char * const opts_nosuggest[] =
     "--slice-max-size",
     "--slice-max-mbs",
     "--slice-min-mbs",
+    "--slice-first-rows",
+    "--speed",
+    "--speed-bufsize",
     "--sps-id",
     "--sync-lookahead",
     "--threads",
@@ -159,9 +163,12 @@ static const char * const opts_nosuggest[] =
 /* Options requiring a filename. */
 static const char * const opts_filename[] =
 {
+    "--cpu-autotune-cache",
     "--cqmfile",
     "--dump-yuv",
     "--index",
+    "--lookahead-in",
+    "--lookahead-out",
     "--opencl-clbin",
     "--output", "-o",
     "--qpfile",
@@ -180,13 +187,16 @@ static const char * const opts_standalone[] =
     "--bluray-compat",
     "--cabac",
     "--constrained-intra",
+    "--cpu-autotune",
     "--cpu-independent",
     "--dts-compress",
     "--fake-interlaced",
     "--fast-pskip",
     "--filler",
     "--force-cfr",
+    "--lookahead-hme",
     "--mbtree",
+    "--mbtree-incremental",
     "--mixed-refs",
     "--no-8x8dct",
     "--no-asm",
@@ -207,7 +217,9 @@ static const char * const opts_standalone[] =
     "--pic-struct",
     "--psnr",
     "--quiet",
+    "--scenecut-prefilter",
     "--sliced-threads",
+    "--sliced-threads-balance",
     "--slow-firstpass",
     "--ssim",
     "--stitchable",
@@ -0,0 +1,461 @@
+/*****************************************************************************
+ * autotune.c: runtime kernel selection
+ *****************************************************************************
+ * Copyright (C) 2003-2022 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "autotune.h"
+
+/* The candidates for each function pointer are the implementations the init
+ * functions pick for a series of reduced cpu masks, the same way checkasm walks
+ * the flag levels.  Each candidate is checked against the default on random data
+ * and then timed with checkasm's method: batches of calls, discarding batches
+ * that took more than 4x the running average. */
+
+#define AUTOTUNE_MAX_CANDIDATES 32
+#define AUTOTUNE_RUNS 64
+#define REF_STRIDE 64
+
+#if HAVE_X86_INLINE_ASM
+#define AUTOTUNE_BATCH 4
+#else
+#define AUTOTUNE_BATCH 64
+#endif
+
+static inline uint32_t read_time( void )
+{
+#if HAVE_X86_INLINE_ASM
+    uint32_t a;
+    asm volatile( "lfence \n"
+                  "rdtsc  \n"
+                  : "=a"(a) :: "edx", "memory" );
+    return a;
+#else
+    return x264_mdate();
+#endif
+}
+
+typedef struct
+{
+    x264_pixel_function_t pixf;
+    x264_dct_function_t   dctf;
+    x264_mc_functions_t   mc;
+} autotune_tables_t;
+
+/* everything the kernels write, compared between candidates */
+typedef struct
+{
+    ALIGNED_64( pixel dst[FDEC_STRIDE*16] );
+    ALIGNED_64( dctcoef dct[4*64] );
+    int out[4];
+} autotune_result_t;
+
+typedef struct
+{
+    ALIGNED_64( pixel fenc[FENC_STRIDE*16] );
+    ALIGNED_64( pixel fdec[FDEC_STRIDE*16] );
+    ALIGNED_64( pixel ref[REF_STRIDE*20] );
+    ALIGNED_64( dctcoef coef[4*64] );
+    autotune_result_t init;
+    autotune_result_t res;
+    autotune_result_t ref_res;
+} autotune_buf_t;
+
+typedef void (*autotune_fn_t)( void );
+typedef void (*autotune_run_t)( autotune_fn_t f, autotune_buf_t *b, int size );
+
+/* unaligned reference blocks, as seen by motion search */
+#define REF(i) (b->ref + (i)*REF_STRIDE + 2*(i) + 1)
+
+static void run_sad( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    b->res.out[0] = ((x264_pixel_cmp_t)f)( b->fenc, FENC_STRIDE, REF(0), REF_STRIDE );
+}
+
+static void run_cmp( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    b->res.out[0] = ((x264_pixel_cmp_t)f)( b->fenc, FENC_STRIDE, b->fdec, FDEC_STRIDE );
+}
+
+static void run_sad_x3( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((x264_pixel_cmp_x3_t)f)( b->fenc, REF(0), REF(1), REF(2), REF_STRIDE, b->res.out );
+}
+
+static void run_sad_x4( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((x264_pixel_cmp_x4_t)f)( b->fenc, REF(0), REF(1), REF(2), REF(3), REF_STRIDE, b->res.out );
+}
+
+static void run_sub_dct( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((void (*)( dctcoef *, pixel *, pixel * ))f)( b->res.dct, b->fenc, b->fdec );
+}
+
+static void run_add_idct( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((void (*)( pixel *, dctcoef * ))f)( b->res.dst, b->coef );
+}
+
+static void run_avg( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((void (*)( pixel *, intptr_t, pixel *, intptr_t, pixel *, intptr_t, int ))f)
+        ( b->res.dst, FDEC_STRIDE, REF(0), REF_STRIDE, REF(1), REF_STRIDE, 32 );
+}
+
+static void run_copy( autotune_fn_t f, autotune_buf_t *b, int size )
+{
+    ((void (*)( pixel *, intptr_t, pixel *, intptr_t, int ))f)
+        ( b->res.dst, FDEC_STRIDE, b->ref, REF_STRIDE, x264_pixel_size[size].h );
+}
+
+#define TABLE(field) offsetof( autotune_tables_t, field )
+
+static const struct
+{
+    const char *name;
+    size_t offset;
+    int sizes;  /* number of PIXEL_* sizes in the array, 0 for a single function */
+    autotune_run_t run;
+} families[] =
+{
+    { "sad",            TABLE( pixf.sad ),         7, run_sad },
+    { "ssd",            TABLE( pixf.ssd ),         8, run_cmp },
+    { "satd",           TABLE( pixf.satd ),        8, run_cmp },
+    { "sa8d",           TABLE( pixf.sa8d ),        4, run_cmp },
+    { "sad_x3",         TABLE( pixf.sad_x3 ),      7, run_sad_x3 },
+    { "sad_x4",         TABLE( pixf.sad_x4 ),      7, run_sad_x4 },
+    { "sub4x4_dct",     TABLE( dctf.sub4x4_dct ),     0, run_sub_dct },
+    { "sub8x8_dct",     TABLE( dctf.sub8x8_dct ),     0, run_sub_dct },
+    { "sub16x16_dct",   TABLE( dctf.sub16x16_dct ),   0, run_sub_dct },
+    { "sub8x8_dct8",    TABLE( dctf.sub8x8_dct8 ),    0, run_sub_dct },
+    { "sub16x16_dct8",  TABLE( dctf.sub16x16_dct8 ),  0, run_sub_dct },
+    { "add4x4_idct",    TABLE( dctf.add4x4_idct ),    0, run_add_idct },
+    { "add8x8_idct",    TABLE( dctf.add8x8_idct ),    0, run_add_idct },
+    { "add16x16_idct",  TABLE( dctf.add16x16_idct ),  0, run_add_idct },
+    { "add8x8_idct8",   TABLE( dctf.add8x8_idct8 ),   0, run_add_idct },
+    { "add16x16_idct8", TABLE( dctf.add16x16_idct8 ), 0, run_add_idct },
+    { "avg",            TABLE( mc.avg ),          12, run_avg },
+    { "copy",           TABLE( mc.copy ),          7, run_copy },
+};
+
+static autotune_fn_t get_fn( autotune_tables_t *t, size_t offset )
+{
+    autotune_fn_t f;
+    memcpy( &f, (uint8_t*)t + offset, sizeof(f) );
+    return f;
+}
+
+static void set_fn( autotune_tables_t *t, size_t offset, autotune_fn_t f )
+{
+    memcpy( (uint8_t*)t + offset, &f, sizeof(f) );
+}
+
+static void slot_name( char *name, int family, int size )
+{
+    if( families[family].sizes )
+        sprintf( name, "%s_%dx%d", families[family].name, x264_pixel_size[size].w, x264_pixel_size[size].h );
+    else
+        strcpy( name, families[family].name );
+}
+
+/* The default mask first, then each ISA level stripped off from the top, then
+ * the default with each of the microarchitecture hints toggled. */
+static int candidates( uint32_t cpu, uint32_t *masks )
+{
+#if ARCH_X86 || ARCH_X86_64
+    static const uint32_t levels[] =
+    {
+        X264_CPU_MMX|X264_CPU_MMX2, X264_CPU_SSE, X264_CPU_SSE2, X264_CPU_LZCNT,
+        X264_CPU_SSE3, X264_CPU_SSSE3, X264_CPU_SSE4, X264_CPU_SSE42, X264_CPU_AVX,
+        X264_CPU_XOP, X264_CPU_FMA4, X264_CPU_FMA3, X264_CPU_BMI1, X264_CPU_BMI2,
+        X264_CPU_AVX2, X264_CPU_AVX512
+    };
+    static const uint32_t hints[] =
+    {
+        X264_CPU_CACHELINE_64, X264_CPU_SLOW_SHUFFLE, X264_CPU_SLOW_PSHUFB, X264_CPU_SLOW_PALIGNR
+    };
+#elif ARCH_PPC
+    static const uint32_t levels[] = { X264_CPU_ALTIVEC };
+    static const uint32_t hints[] = { 0 };
+#elif ARCH_ARM
+    static const uint32_t levels[] = { X264_CPU_ARMV6, X264_CPU_NEON };
+    static const uint32_t hints[] = { X264_CPU_FAST_NEON_MRC };
+#elif ARCH_AARCH64
+    static const uint32_t levels[] = { X264_CPU_ARMV8, X264_CPU_NEON };
+    static const uint32_t hints[] = { 0 };
+#elif ARCH_MIPS
+    static const uint32_t levels[] = { X264_CPU_MSA };
+    static const uint32_t hints[] = { 0 };
+#else
+    static const uint32_t levels[] = { 0 };
+    static const uint32_t hints[] = { 0 };
+#endif
+    int n = 0;
+    uint32_t strip = 0;
+    masks[n++] = cpu;
+    for( int i = ARRAY_ELEMS(levels) - 1; i >= 0; i-- )
+        if( cpu & levels[i] )
+        {
+            strip |= levels[i];
+            masks[n++] = cpu & ~strip;
+        }
+    if( n > 1 )
+        for( int i = 0; i < ARRAY_ELEMS(hints); i++ )
+            if( hints[i] )
+                masks[n++] = cpu ^ hints[i];
+    return n;
+}
+
+static uint64_t bench( autotune_fn_t f, autotune_run_t run, autotune_buf_t *b, int size )
+{
+    uint64_t tsum = 0;
+    int tcount = 0;
+    run( f, b, size );
+    for( int i = 0; i < AUTOTUNE_RUNS; i++ )
+    {
+        uint32_t t = read_time();
+        for( int j = 0; j < AUTOTUNE_BATCH; j++ )
+            run( f, b, size );
+        t = read_time() - t;
+        if( (uint64_t)t*tcount <= tsum*4 && i > 0 )
+        {
+            tsum += t;
+            tcount++;
+        }
+    }
+    return tcount ? (tsum << 4) / tcount : UINT64_MAX;
+}
+
+/* Returns the index of the fastest candidate for one function pointer, or -1 if
+ * there is only one implementation to choose from. */
+static int tune_slot( x264_t *h, autotune_tables_t *t, const uint32_t *masks, int n,
+                      autotune_buf_t *b, int family, int size, const char *name )
+{
+    size_t offset = families[family].offset + size * sizeof(autotune_fn_t);
+    autotune_run_t run = families[family].run;
+    autotune_fn_t def = get_fn( &t[0], offset );
+    uint64_t time[AUTOTUNE_MAX_CANDIDATES];
+    int best = 0;
+    int distinct = 1;
+
+    if( !def )
+        return -1;
+
+    b->res = b->init;
+    run( def, b, size );
+    b->ref_res = b->res;
+
+    for( int c = 0; c < n; c++ )
+    {
+        autotune_fn_t f = get_fn( &t[c], offset );
+        time[c] = UINT64_MAX;
+        if( !f )
+            continue;
+        if( c > 0 )
+        {
+            int dup = 0;
+            for( int i = 0; i < c; i++ )
+                dup |= get_fn( &t[i], offset ) == f;
+            if( dup )
+                continue;
+            b->res = b->init;
+            run( f, b, size );
+            if( memcmp( &b->res, &b->ref_res, sizeof(autotune_result_t) ) )
+            {
+                x264_log( h, X264_LOG_DEBUG, "autotune: %s for cpu %#x does not match the default\n", name, masks[c] );
+                continue;
+            }
+            distinct++;
+        }
+        time[c] = bench( f, run, b, size );
+    }
+    if( distinct < 2 )
+        return -1;
+
+    for( int c = 1; c < n; c++ )
+        if( time[c] < time[best] )
+            best = c;
+    /* don't switch for differences within the measurement noise */
+    if( best && time[best] * 32 >= time[0] * 31 )
+        best = 0;
+    if( best )
+        x264_log( h, X264_LOG_DEBUG, "autotune: %s: cpu %#x is %.1f%% faster than the default\n",
+                  name, masks[best], 100.0 * (time[0] - time[best]) / time[0] );
+    return best;
+}
+
+static void init_buf( autotune_buf_t *b )
+{
+    uint32_t seed = 1;
+#define RAND() (seed = seed * 1664525 + 1013904223, seed >> 16)
+    for( int i = 0; i < FENC_STRIDE*16; i++ )
+        b->fenc[i] = RAND() & PIXEL_MAX;
+    for( int i = 0; i < FDEC_STRIDE*16; i++ )
+        b->fdec[i] = RAND() & PIXEL_MAX;
+    for( int i = 0; i < REF_STRIDE*20; i++ )
+        b->ref[i] = RAND() & PIXEL_MAX;
+    for( int i = 0; i < 4*64; i++ )
+        b->coef[i] = (int)(RAND() & 31) - 16;
+#undef RAND
+    memset( &b->init, 0, sizeof(autotune_result_t) );
+    memcpy( b->init.dst, b->fdec, sizeof(b->init.dst) );
+}
+
+/* The cache is a text file: a header with the build, bit depth and cpu flags it
+ * was made for, then one "name cpu" line per tuned function pointer. */
+static int load_cache( x264_t *h, autotune_tables_t *t, const uint32_t *masks, int n )
+{
+    char *buf = x264_slurp_file( h->param.psz_cpu_autotune_cache );
+    char *line, *saveptr = NULL;
+    int build, depth, len, ret = 0;
+    unsigned cpu;
+    autotune_tables_t tuned = t[0];
+
+    if( !buf )
+        return 0;
+    if( sscanf( buf, "x264-autotune %d %d %x%n", &build, &depth, &cpu, &len ) != 3 ||
+        build != X264_BUILD || depth != BIT_DEPTH || cpu != h->param.cpu )
+        goto end;
+
+    for( char *p = buf + len; (line = strtok_r( p, "\n", &saveptr )); p = NULL )
+    {
+        char name[32], slot[32];
+        unsigned mask;
+        int found = 0;
+        if( sscanf( line, "%31s %x", name, &mask ) != 2 )
+            goto end;
+        for( int family = 0; family < ARRAY_ELEMS(families) && !found; family++ )
+            for( int size = 0; size < X264_MAX( families[family].sizes, 1 ) && !found; size++ )
+            {
+                slot_name( slot, family, size );
+                if( strcmp( slot, name ) )
+                    continue;
+                for( int c = 0; c < n && !found; c++ )
+                    if( masks[c] == mask )
+                    {
+                        size_t offset = families[family].offset + size * sizeof(autotune_fn_t);
+                        set_fn( &tuned, offset, get_fn( &t[c], offset ) );
+                        found = 1;
+                    }
+                if( !found )
+                    goto end;
+            }
+        if( !found )
+            goto end;
+    }
+    t[0] = tuned;
+    ret = 1;
+end:
+    if( !ret )
+        x264_log( h, X264_LOG_INFO, "autotune: %s is out of date, rebuilding\n", h->param.psz_cpu_autotune_cache );
+    x264_free( buf );
+    return ret;
+}
+
+static void save_cache( x264_t *h, const char *lines )
+{
+    const char *filename = h->param.psz_cpu_autotune_cache;
+    char *tmpname = x264_malloc( strlen( filename ) + 6 );
+    FILE *f;
+    if( !tmpname )
+        return;
+    sprintf( tmpname, "%s.temp", filename );
+    f = x264_fopen( tmpname, "wb" );
+    if( !f )
+        x264_log( h, X264_LOG_WARNING, "autotune: can't write to %s\n", tmpname );
+    else
+    {
+        int ok = fprintf( f, "x264-autotune %d %d %#x\n%s", X264_BUILD, BIT_DEPTH, h->param.cpu, lines ) >= 0;
+        ok &= !fclose( f );
+        if( !ok || x264_rename( tmpname, filename ) < 0 )
+            x264_log( h, X264_LOG_WARNING, "autotune: failed to write %s\n", filename );
+    }
+    x264_free( tmpname );
+}
+
+int x264_autotune( x264_t *h )
+{
+    uint32_t masks[AUTOTUNE_MAX_CANDIDATES];
+    int n = candidates( h->param.cpu, masks );
+    autotune_tables_t *t = NULL;
+    autotune_buf_t *b = NULL;
+    char *lines = NULL;
+    char *p;
+    int replaced = 0, total = 0;
+    autotune_tables_t tuned;
+
+    if( n < 2 )
+        return 0;
+
+    CHECKED_MALLOC( t, n * sizeof(autotune_tables_t) );
+    for( int c = 0; c < n; c++ )
+    {
+        x264_pixel_init( masks[c], &t[c].pixf );
+        x264_dct_init( masks[c], &t[c].dctf );
+        x264_mc_init( masks[c], &t[c].mc, h->param.b_cpu_independent );
+    }
+
+    if( h->param.psz_cpu_autotune_cache && load_cache( h, t, masks, n ) )
+    {
+        x264_log( h, X264_LOG_INFO, "autotune: using %s\n", h->param.psz_cpu_autotune_cache );
+        goto install;
+    }
+
+    CHECKED_MALLOC( b, sizeof(autotune_buf_t) );
+    CHECKED_MALLOC( lines, ARRAY_ELEMS(families) * 12 * 48 );
+    init_buf( b );
+    p = lines;
+    *p = 0;
+    tuned = t[0];
+    for( int family = 0; family < ARRAY_ELEMS(families); family++ )
+        for( int size = 0; size < X264_MAX( families[family].sizes, 1 ); size++ )
+        {
+            size_t offset = families[family].offset + size * sizeof(autotune_fn_t);
+            char name[32];
+            slot_name( name, family, size );
+            int best = tune_slot( h, t, masks, n, b, family, size, name );
+            if( best < 0 )
+                continue;
+            set_fn( &tuned, offset, get_fn( &t[best], offset ) );
+            p += sprintf( p, "%s %#x\n", name, masks[best] );
+            replaced += !!best;
+            total++;
+        }
+    t[0] = tuned;
+    x264_log( h, X264_LOG_INFO, "autotune: replaced %d of %d kernels\n", replaced, total );
+    if( h->param.psz_cpu_autotune_cache )
+        save_cache( h, lines );
+
+install:
+    h->pixf = t[0].pixf;
+    h->dctf = t[0].dctf;
+    h->mc   = t[0].mc;
+    x264_free( lines );
+    x264_free( b );
+    x264_free( t );
+    return 0;
+fail:
+    x264_free( lines );
+    x264_free( b );
+    x264_free( t );
+    return -1;
+}
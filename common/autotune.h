@@ -0,0 +1,35 @@
+/*****************************************************************************
+ * autotune.h: runtime kernel selection
+ *****************************************************************************
+ * Copyright (C) 2003-2022 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#ifndef X264_AUTOTUNE_H
+#define X264_AUTOTUNE_H
+
+/* Time every implementation of the pixel, dct and mc kernels that the cpu flags
+ * allow and install the fastest one in h->pixf, h->dctf and h->mc.  Must be
+ * called after the init functions and before anything copies from those tables.
+ * Only kernels that give identical results to the default are considered, so the
+ * output does not change. */
+#define x264_autotune x264_template(autotune)
+int x264_autotune( x264_t *h );
+
+#endif
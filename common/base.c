@@ -352,6 +352,8 @@ REALIGN_STACK void x264_param_default( x264_param_t *param )
     param->i_lookahead_threads = X264_THREADS_AUTO;
     param->b_deterministic = 1;
     param->i_sync_lookahead = X264_SYNC_LOOKAHEAD_AUTO;
+    param->sc.f_speed = 0;
+    param->sc.i_buffer_size = 30;
 
     /* Video properties */
     param->i_csp           = X264_CHROMA_FORMAT ? X264_CHROMA_FORMAT : X264_CSP_I420;
@@ -386,6 +388,7 @@ REALIGN_STACK void x264_param_default( x264_param_t *param )
     param->i_keyint_min = X264_KEYINT_MIN_AUTO;
     param->i_bframe = 3;
     param->i_scenecut_threshold = 40;
+    param->b_scenecut_prefilter = 0;
     param->i_bframe_adaptive = X264_B_ADAPT_FAST;
     param->i_bframe_bias = 0;
     param->i_bframe_pyramid = X264_B_PYRAMID_NORMAL;
@@ -425,6 +428,7 @@ REALIGN_STACK void x264_param_default( x264_param_t *param )
     param->rc.f_complexity_blur = 20;
     param->rc.i_zones = 0;
     param->rc.b_mb_tree = 1;
+    param->rc.b_mb_tree_incremental = 0;
 
     /* Log */
     param->pf_log = x264_log_default;
@@ -445,9 +449,11 @@ REALIGN_STACK void x264_param_default( x264_param_t *param )
     param->analyse.b_mixed_references = 1;
     param->analyse.b_chroma_me = 1;
     param->analyse.i_mv_range_thread = -1;
+    param->analyse.b_lookahead_hme = 0;
     param->analyse.i_mv_range = -1; // set from level_idc
     param->analyse.i_chroma_qp_offset = 0;
     param->analyse.b_fast_pskip = 1;
+    param->analyse.i_fast_decision = 0;
     param->analyse.b_weighted_bipred = 1;
     param->analyse.i_weighted_pred = X264_WEIGHTP_SMART;
     param->analyse.b_dct_decimate = 1;
@@ -967,6 +973,8 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
     }
     OPT("sliced-threads")
         p->b_sliced_threads = atobool(value);
+    OPT("sliced-threads-balance")
+        p->b_sliced_threads_balance = atobool(value);
     OPT("sync-lookahead")
     {
         if( !strcasecmp(value, "auto") )
@@ -978,6 +986,16 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
         p->b_deterministic = atobool(value);
     OPT("cpu-independent")
         p->b_cpu_independent = atobool(value);
+    OPT("frame-prealloc")
+        p->b_frame_prealloc = atobool(value);
+    OPT("cpu-autotune")
+        p->b_cpu_autotune = atobool(value);
+    OPT("cpu-autotune-cache")
+        CHECKED_ERROR_PARAM_STRDUP( p->psz_cpu_autotune_cache, p, value );
+    OPT("speed")
+        p->sc.f_speed = atof(value);
+    OPT("speed-bufsize")
+        p->sc.i_buffer_size = atoi(value);
     OPT2("level", "level-idc")
     {
         if( !strcmp(value, "1b") )
@@ -1096,6 +1114,8 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
             p->i_scenecut_threshold = atoi(value);
         }
     }
+    OPT("scenecut-prefilter")
+        p->b_scenecut_prefilter = atobool(value);
     OPT("intra-refresh")
         p->b_intra_refresh = atobool(value);
     OPT("bframes")
@@ -1149,6 +1169,8 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
         p->i_slice_count = atoi(value);
     OPT("slices-max")
         p->i_slice_count_max = atoi(value);
+    OPT("slice-first-rows")
+        p->i_slice_first_rows = atoi(value);
     OPT("cabac")
         p->b_cabac = atobool(value);
     OPT("cabac-idc")
@@ -1269,6 +1291,8 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
         p->analyse.i_mv_range = atoi(value);
     OPT2("mvrange-thread", "mv-range-thread")
         p->analyse.i_mv_range_thread = atoi(value);
+    OPT("lookahead-hme")
+        p->analyse.b_lookahead_hme = atobool(value);
     OPT2("subme", "subq")
         p->analyse.i_subpel_refine = atoi(value);
     OPT("psy-rd")
@@ -1297,6 +1321,8 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
         p->analyse.i_trellis = atoi(value);
     OPT("fast-pskip")
         p->analyse.b_fast_pskip = atobool(value);
+    OPT("fast-decision")
+        p->analyse.i_fast_decision = atoi(value);
     OPT("dct-decimate")
         p->analyse.b_dct_decimate = atobool(value);
     OPT("deadzone-inter")
@@ -1357,10 +1383,16 @@ REALIGN_STACK int x264_param_parse( x264_param_t *p, const char *name, const cha
         CHECKED_ERROR_PARAM_STRDUP( p->rc.psz_stat_in, p, value );
         CHECKED_ERROR_PARAM_STRDUP( p->rc.psz_stat_out, p, value );
     }
+    OPT("lookahead-out")
+        CHECKED_ERROR_PARAM_STRDUP( p->rc.psz_lookahead_out, p, value );
+    OPT("lookahead-in")
+        CHECKED_ERROR_PARAM_STRDUP( p->rc.psz_lookahead_in, p, value );
     OPT("qcomp")
         p->rc.f_qcompress = atof(value);
     OPT("mbtree")
         p->rc.b_mb_tree = atobool(value);
+    OPT("mbtree-incremental")
+        p->rc.b_mb_tree_incremental = atobool(value);
     OPT("qblur")
         p->rc.f_qblur = atof(value);
     OPT2("cplxblur", "cplx-blur")
@@ -1457,16 +1489,24 @@ char *x264_param2string( x264_param_t *p, int b_res )
         s += sprintf( s, " psy_rd=%.2f:%.2f", p->analyse.f_psy_rd, p->analyse.f_psy_trellis );
     s += sprintf( s, " mixed_ref=%d", p->analyse.b_mixed_references );
     s += sprintf( s, " me_range=%d", p->analyse.i_me_range );
+    if( p->analyse.b_lookahead_hme )
+        s += sprintf( s, " lookahead_hme=%d", p->analyse.b_lookahead_hme );
     s += sprintf( s, " chroma_me=%d", p->analyse.b_chroma_me );
     s += sprintf( s, " trellis=%d", p->analyse.i_trellis );
     s += sprintf( s, " 8x8dct=%d", p->analyse.b_transform_8x8 );
     s += sprintf( s, " cqm=%d", p->i_cqm_preset );
     s += sprintf( s, " deadzone=%d,%d", p->analyse.i_luma_deadzone[0], p->analyse.i_luma_deadzone[1] );
     s += sprintf( s, " fast_pskip=%d", p->analyse.b_fast_pskip );
+    if( p->analyse.i_fast_decision )
+        s += sprintf( s, " fast_decision=%d", p->analyse.i_fast_decision );
     s += sprintf( s, " chroma_qp_offset=%d", p->analyse.i_chroma_qp_offset );
     s += sprintf( s, " threads=%d", p->i_threads );
     s += sprintf( s, " lookahead_threads=%d", p->i_lookahead_threads );
     s += sprintf( s, " sliced_threads=%d", p->b_sliced_threads );
+    if( p->b_sliced_threads_balance )
+        s += sprintf( s, " sliced_threads_balance=1" );
+    if( p->sc.f_speed > 0 )
+        s += sprintf( s, " speed=%.2f speed_bufsize=%d", p->sc.f_speed, p->sc.i_buffer_size );
     if( p->i_slice_count )
         s += sprintf( s, " slices=%d", p->i_slice_count );
     if( p->i_slice_count_max )
@@ -1477,6 +1517,8 @@ char *x264_param2string( x264_param_t *p, int b_res )
         s += sprintf( s, " slice_max_mbs=%d", p->i_slice_max_mbs );
     if( p->i_slice_min_mbs )
         s += sprintf( s, " slice_min_mbs=%d", p->i_slice_min_mbs );
+    if( p->i_slice_first_rows )
+        s += sprintf( s, " slice_first_rows=%d", p->i_slice_first_rows );
     s += sprintf( s, " nr=%d", p->analyse.i_noise_reduction );
     s += sprintf( s, " decimate=%d", p->analyse.b_dct_decimate );
     s += sprintf( s, " interlaced=%s", p->b_interlaced ? p->b_tff ? "tff" : "bff" : p->b_fake_interlaced ? "fake" : "0" );
@@ -1501,6 +1543,8 @@ char *x264_param2string( x264_param_t *p, int b_res )
         s += sprintf( s, " keyint=%d", p->i_keyint_max );
     s += sprintf( s, " keyint_min=%d scenecut=%d intra_refresh=%d",
                   p->i_keyint_min, p->i_scenecut_threshold, p->b_intra_refresh );
+    if( p->b_scenecut_prefilter )
+        s += sprintf( s, " scenecut_prefilter=%d", p->b_scenecut_prefilter );
 
     if( p->rc.b_mb_tree || p->rc.i_vbv_buffer_size )
         s += sprintf( s, " rc_lookahead=%d", p->rc.i_lookahead );
@@ -1508,6 +1552,8 @@ char *x264_param2string( x264_param_t *p, int b_res )
     s += sprintf( s, " rc=%s mbtree=%d", p->rc.i_rc_method == X264_RC_ABR ?
                                ( p->rc.b_stat_read ? "2pass" : p->rc.i_vbv_max_bitrate == p->rc.i_bitrate ? "cbr" : "abr" )
                                : p->rc.i_rc_method == X264_RC_CRF ? "crf" : "cqp", p->rc.b_mb_tree );
+    if( p->rc.b_mb_tree_incremental )
+        s += sprintf( s, " mbtree_incremental=%d", p->rc.b_mb_tree_incremental );
     if( p->rc.i_rc_method == X264_RC_ABR || p->rc.i_rc_method == X264_RC_CRF )
     {
         if( p->rc.i_rc_method == X264_RC_CRF )
@@ -45,6 +45,8 @@
 #define x264_encoder_maximum_delayed_frames x264_template(encoder_maximum_delayed_frames)
 #define x264_encoder_intra_refresh x264_template(encoder_intra_refresh)
 #define x264_encoder_invalidate_reference x264_template(encoder_invalidate_reference)
+#define x264_encoder_reset x264_template(encoder_reset)
+#define x264_encoder_frame_pool_stats x264_template(encoder_frame_pool_stats)
 
 /* This undef allows to rename the external symbol and force link failure in case
  * of incompatible libraries. Then the define enables templating as above. */
@@ -229,6 +231,7 @@ typedef struct x264_lookahead_t
 } x264_lookahead_t;
 
 typedef struct x264_ratecontrol_t   x264_ratecontrol_t;
+typedef struct x264_speedcontrol_t  x264_speedcontrol_t;
 
 typedef struct x264_left_table_t
 {
@@ -265,6 +268,8 @@ typedef struct
     int64_t i_ssd[3];
     double f_ssim;
     int i_ssim_cnt;
+    /* Time from x264_encoder_encode to the end of the first slice, with slice-first-rows */
+    int64_t i_first_slice_latency;
 } x264_frame_stat_t;
 
 struct x264_t
@@ -282,6 +287,9 @@ struct x264_t
     int             i_threadslice_start; /* first row in this thread slice */
     int             i_threadslice_end; /* row after the end of this thread slice */
     int             i_threadslice_pass; /* which pass of encoding we are on */
+    int             *row_bits_last[3]; /* sliced-threads-balance: row bits of the last frame of each slice type */
+    int             i_slice_target_bits; /* slice-first-rows: size at which to end later slices */
+    int64_t         i_encode_start; /* time of the x264_encoder_encode call that started this frame */
     x264_threadpool_t *threadpool;
     x264_threadpool_t *lookaheadpool;
     x264_pthread_mutex_t mutex;
@@ -350,6 +358,7 @@ struct x264_t
     /* mv/ref/mode cost arrays. */
     uint16_t *cost_mv[QP_MAX+1];
     uint16_t *cost_mv_fpel[QP_MAX+1][4];
+    struct x264_mv_costs_t *mv_costs; /* process-wide owner of cost_mv/cost_mv_fpel */
     struct
     {
         uint16_t ref[QP_MAX+1][3][33];
@@ -403,6 +412,9 @@ struct x264_t
         int64_t i_prev_reordered_pts[2];
         int64_t i_largest_pts;
         int64_t i_second_largest_pts;
+        int     i_allocated[2];     /* Frames allocated so far: 0 = fenc, 1 = fdec */
+        int     i_preallocated[2];  /* Of which allocated by x264_encoder_open */
+        int64_t i_allocated_size;
         int b_have_lowres;  /* Whether 1/2 resolution luma planes are being used */
         int b_have_sub8x8_esa;
     } frames;
@@ -563,6 +575,7 @@ struct x264_t
         int ip_offset; /* Used by PIR to offset the quantizer of intra-refresh blocks. */
         int b_deblock_rdo;
         int b_overflow; /* If CAVLC had a level code overflow during bitstream writing. */
+        int b_load_i4x4_modes; /* The slice can contain I_4x4/I_8x8, so cache_load needs the neighbouring intra modes. */
 
         struct
         {
@@ -680,6 +693,8 @@ struct x264_t
 
     /* rate control encoding only */
     x264_ratecontrol_t *rc;
+    /* speed control, shared by all threads */
+    x264_speedcontrol_t *sc;
 
     /* stats */
     struct
@@ -712,6 +727,8 @@ struct x264_t
         int     i_direct_frames[2];
         /* num p-frames weighted */
         int     i_wpred[2];
+        /* first slice latency: sum, max */
+        int64_t i_first_slice_latency[2];
 
         /* Current frame stats */
         x264_frame_stat_t frame;
@@ -731,6 +748,7 @@ struct x264_t
     /* Buffers that are allocated per-thread even in sliced threads. */
     void *scratch_buffer; /* for any temporary storage that doesn't want repeated malloc */
     void *scratch_buffer2; /* if the first one's already in use */
+    uint16_t *mbtree_propagate_acc; /* lookahead threads: private MB-tree propagate costs of up to 3 frames */
     pixel *intra_border_backup[5][3]; /* bottom pixels of the previous mb row, used for intra prediction after the framebuffer has been deblocked */
     /* Deblock strength values are stored for each 4x4 partition. In MBAFF
      * there are four extra values that need to be stored, located in [4][i]. */
@@ -375,6 +375,24 @@ static ALWAYS_INLINE void macroblock_cache_load_neighbours_deblock( x264_t *h, i
         h->mb.i_neighbour |= MB_TOP;
 }
 
+/* Progressive only: an inter macroblock with no intra neighbours and all-zero strengths
+ * has no edge that would be filtered, which is the common case for skip runs at fast
+ * presets, so don't bother loading its neighbours or qps. */
+static ALWAYS_INLINE int deblock_mb_is_noop( x264_t *h, int mb_x, int mb_y )
+{
+    int mb_xy = mb_y * h->mb.i_mb_stride + mb_x;
+    uint8_t (*bs)[8][4] = h->deblock_strength[mb_y&1][h->param.b_sliced_threads?mb_xy:mb_x];
+    if( M64( bs[0][0] ) | M64( bs[0][2] ) | M64( bs[1][0] ) | M64( bs[1][2] ) )
+        return 0;
+    if( IS_INTRA( h->mb.type[mb_xy] ) )
+        return 0;
+    if( mb_x && IS_INTRA( h->mb.type[mb_xy-1] ) )
+        return 0;
+    if( mb_y && IS_INTRA( h->mb.type[mb_xy-h->mb.i_mb_stride] ) )
+        return 0;
+    return 1;
+}
+
 void x264_frame_deblock_row( x264_t *h, int mb_y )
 {
     int b_interlaced = SLICE_MBAFF;
@@ -390,6 +408,9 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
 
     for( int mb_x = 0; mb_x < h->mb.i_mb_width; mb_x += (~b_interlaced | mb_y)&1, mb_y ^= b_interlaced )
     {
+        if( !PARAM_INTERLACED && deblock_mb_is_noop( h, mb_x, mb_y ) )
+            continue;
+
         x264_prefetch_fenc( h, h->fdec, mb_x, mb_y );
         macroblock_cache_load_neighbours_deblock( h, mb_x, mb_y );
 
@@ -214,7 +214,30 @@ static x264_frame_t *frame_new( x264_t *h, int b_fdec )
                     PREALLOC( frame->lowres_mvs[j][i], 2*h->mb.i_mb_count*sizeof(int16_t) );
                     PREALLOC( frame->lowres_mv_costs[j][i], h->mb.i_mb_count*sizeof(int) );
                 }
+            if( h->param.analyse.b_lookahead_hme )
+            {
+                for( int i = 0; i < 2; i++ )
+                {
+                    frame->i_width_hme[i] = frame->i_width_lowres >> (i+1);
+                    frame->i_lines_hme[i] = frame->i_lines_lowres >> (i+1);
+                    frame->i_stride_hme[i] = align_stride( frame->i_width_hme[i] + PADH2, align, disalign );
+                    PREALLOC( frame->buffer_hme[i], frame->i_stride_hme[i] * (frame->i_lines_hme[i] + 2*PADV) * SIZEOF_PIXEL );
+                }
+                /* One mv per 8x8 block at both levels; the eighth-res ones are only needed during the search. */
+                int hme_mv_count = ((h->mb.i_mb_width+1)>>1) * ((h->mb.i_mb_height+1)>>1)
+                                 + ((h->mb.i_mb_width+3)>>2) * ((h->mb.i_mb_height+3)>>2);
+                for( int j = 0; j <= !!h->param.i_bframe; j++ )
+                    for( int i = 0; i <= h->param.i_bframe; i++ )
+                        PREALLOC( frame->lowres_hme_mvs[j][i], hme_mv_count * 2*sizeof(int16_t) );
+            }
             PREALLOC( frame->i_propagate_cost, i_mb_count * sizeof(uint16_t) );
+            if( h->param.b_scenecut_prefilter )
+                PREALLOC( frame->i_lowres_luma, i_mb_count * sizeof(uint16_t) );
+            if( h->param.rc.b_mb_tree_incremental )
+            {
+                PREALLOC( frame->i_propagate_cost_done, i_mb_count * sizeof(uint16_t) );
+                PREALLOC( frame->i_propagate_cost_bframes, i_mb_count * sizeof(uint16_t) );
+            }
             for( int j = 0; j <= h->param.i_bframe+1; j++ )
                 for( int i = 0; i <= h->param.i_bframe+1; i++ )
                     PREALLOC( frame->lowres_costs[j][i], i_mb_count * sizeof(uint16_t) );
@@ -233,6 +256,13 @@ static x264_frame_t *frame_new( x264_t *h, int b_fdec )
 
     PREALLOC_END( frame->base );
 
+    /* Fault the pages in now rather than on first use in the middle of a frame. */
+    if( h->param.b_frame_prealloc )
+        for( int64_t i = 0; i < prealloc_size; i += 4096 )
+            frame->base[i] = 0;
+    h->frames.i_allocated[b_fdec]++;
+    h->frames.i_allocated_size += prealloc_size;
+
     if( i_csp == X264_CSP_NV12 || i_csp == X264_CSP_NV16 )
     {
         int chroma_padv = i_padv >> (i_csp == X264_CSP_NV12);
@@ -278,6 +308,9 @@ static x264_frame_t *frame_new( x264_t *h, int b_fdec )
             int64_t luma_plane_size = align_plane_size( frame->i_stride_lowres * (frame->i_lines[0]/2 + 2*PADV), disalign );
             for( int i = 0; i < 4; i++ )
                 frame->lowres[i] = frame->buffer_lowres + frame->i_stride_lowres * PADV + PADH_ALIGN + i * luma_plane_size;
+            if( h->param.analyse.b_lookahead_hme )
+                for( int i = 0; i < 2; i++ )
+                    frame->lowres_hme[i] = frame->buffer_hme[i] + frame->i_stride_hme[i] * PADV + PADH_ALIGN;
 
             for( int j = 0; j <= !!h->param.i_bframe; j++ )
                 for( int i = 0; i <= h->param.i_bframe; i++ )
@@ -323,6 +356,8 @@ void x264_frame_delete( x264_frame_t *frame )
         }
         if( frame->mb_info_free )
             frame->mb_info_free( frame->mb_info );
+        if( frame->mb_hints_free )
+            frame->mb_hints_free( frame->mb_hints );
         if( frame->extra_sei.sei_free )
         {
             for( int i = 0; i < frame->extra_sei.num_payloads; i++ )
@@ -405,6 +440,9 @@ int x264_frame_copy_picture( x264_t *h, x264_frame_t *dst, x264_picture_t *src )
     dst->opaque     = src->opaque;
     dst->mb_info    = h->param.analyse.b_mb_info ? src->prop.mb_info : NULL;
     dst->mb_info_free = h->param.analyse.b_mb_info ? src->prop.mb_info_free : NULL;
+    dst->mb_hints   = h->param.analyse.b_mb_info ? src->prop.mb_hints : NULL;
+    dst->mb_hints_free = h->param.analyse.b_mb_info ? src->prop.mb_hints_free : NULL;
+    dst->mb_export  = src->prop.mb_export;
 
     uint8_t *pix[3];
     int stride[3];
@@ -627,6 +665,9 @@ void x264_frame_expand_border_lowres( x264_frame_t *frame )
 {
     for( int i = 0; i < 4; i++ )
         plane_expand_border( frame->lowres[i], frame->i_stride_lowres, frame->i_width_lowres, frame->i_lines_lowres, PADH, PADV, 1, 1, 0 );
+    if( frame->lowres_hme[0] )
+        for( int i = 0; i < 2; i++ )
+            plane_expand_border( frame->lowres_hme[i], frame->i_stride_hme[i], frame->i_width_hme[i], frame->i_lines_hme[i], PADH, PADV, 1, 1, 0 );
 }
 
 void x264_frame_expand_border_chroma( x264_t *h, x264_frame_t *frame, int plane )
@@ -789,6 +830,7 @@ x264_frame_t *x264_frame_pop_unused( x264_t *h, int b_fdec )
     frame->i_reference_count = 1;
     frame->b_intra_calculated = 0;
     frame->b_scenecut = 1;
+    frame->i_mbtree_ref[0] = -1;
     frame->b_keyframe = 0;
     frame->b_corrupt = 0;
     frame->i_slice_count = h->param.b_sliced_threads ? h->param.i_threads : 1;
@@ -799,6 +841,21 @@ x264_frame_t *x264_frame_pop_unused( x264_t *h, int b_fdec )
     return frame;
 }
 
+int x264_frame_pool_fill( x264_t *h, int b_fdec, int i_frames )
+{
+    int i_unused = 0;
+    while( h->frames.unused[b_fdec][i_unused] )
+        i_unused++;
+    for( ; i_unused < i_frames; i_unused++ )
+    {
+        x264_frame_t *frame = frame_new( h, b_fdec );
+        if( !frame )
+            return -1;
+        x264_frame_push( h->frames.unused[b_fdec], frame );
+    }
+    return 0;
+}
+
 void x264_frame_push_blank_unused( x264_t *h, x264_frame_t *frame )
 {
     assert( frame->i_reference_count > 0 );
@@ -880,7 +937,8 @@ void x264_sync_frame_list_push( x264_sync_frame_list_t *slist, x264_frame_t *fra
         x264_pthread_cond_wait( &slist->cv_empty, &slist->mutex );
     slist->list[ slist->i_size++ ] = frame;
     x264_pthread_mutex_unlock( &slist->mutex );
-    x264_pthread_cond_broadcast( &slist->cv_fill );
+    /* One frame in, so at most one waiter can take it; see x264_sync_frame_list_t. */
+    x264_pthread_cond_signal( &slist->cv_fill );
 }
 
 x264_frame_t *x264_sync_frame_list_pop( x264_sync_frame_list_t *slist )
@@ -891,7 +949,7 @@ x264_frame_t *x264_sync_frame_list_pop( x264_sync_frame_list_t *slist )
         x264_pthread_cond_wait( &slist->cv_fill, &slist->mutex );
     frame = slist->list[ --slist->i_size ];
     slist->list[ slist->i_size ] = NULL;
-    x264_pthread_cond_broadcast( &slist->cv_empty );
     x264_pthread_mutex_unlock( &slist->mutex );
+    x264_pthread_cond_signal( &slist->cv_empty );
     return frame;
 }
@@ -77,11 +77,15 @@ typedef struct x264_frame
     int     i_stride_lowres;
     int     i_width_lowres;
     int     i_lines_lowres;
+    int     i_stride_hme[2];
+    int     i_width_hme[2];
+    int     i_lines_hme[2];
     pixel *plane[3];
     pixel *plane_fld[3];
     pixel *filtered[3][4]; /* plane[0], H, V, HV */
     pixel *filtered_fld[3][4];
     pixel *lowres[4]; /* half-size copy of input frame: Orig, H, V, HV */
+    pixel *lowres_hme[2]; /* quarter- and eighth-size copies of input frame for hierarchical lookahead ME */
     uint16_t *integral;
 
     /* for unrestricted mv we allocate more data than needed
@@ -89,6 +93,7 @@ typedef struct x264_frame
     pixel *buffer[4];
     pixel *buffer_fld[4];
     pixel *buffer_lowres;
+    pixel *buffer_hme[2];
 
     x264_weight_t weight[X264_REF_MAX][3]; /* [ref_index][plane] */
     pixel *weighted[X264_REF_MAX]; /* plane[0] weighted of the reference frames */
@@ -101,6 +106,7 @@ typedef struct x264_frame
     int16_t (*mv[2])[2];
     int16_t (*mv16x16)[2];
     int16_t (*lowres_mvs[2][X264_BFRAME_MAX+1])[2];
+    int16_t (*lowres_hme_mvs[2][X264_BFRAME_MAX+1])[2]; /* per 8x8 block of lowres_hme[0], in lowres qpel */
     uint8_t *field;
     uint8_t *effective_qp;
 
@@ -134,8 +140,15 @@ typedef struct x264_frame
     int     b_intra_calculated;
     uint16_t *i_intra_cost;
     uint16_t *i_propagate_cost;
+    uint16_t *i_propagate_cost_done; /* incremental mb-tree: the part of i_propagate_cost already passed on */
+    uint16_t *i_propagate_cost_bframes; /* incremental mb-tree: the part of i_propagate_cost from the preceding b-frames */
+    int     i_mbtree_ref[2]; /* incremental mb-tree: frame numbers this frame was propagated to, -1 if not yet */
+    int     b_mbtree_referenced;
     uint16_t *i_inv_qscale_factor;
     int     b_scenecut; /* Set to zero if the frame cannot possibly be part of a real scenecut. */
+    uint16_t *i_lowres_luma; /* scenecut prefilter: sum of each MB's 8x8 block of lowres[0], at pixel bit depth */
+    int     i_lowres_luma_avg; /* average of i_lowres_luma */
+    int     i_lowres_luma_dev; /* mean absolute deviation of i_lowres_luma */
     float   f_weighted_cost_delta[X264_BFRAME_MAX+2];
     uint32_t i_pixel_sum[3];
     uint64_t i_pixel_ssd[3];
@@ -176,13 +189,23 @@ typedef struct x264_frame
     /* user frame properties */
     uint8_t *mb_info;
     void (*mb_info_free)( void* );
+    x264_mb_hint_t *mb_hints;
+    void (*mb_hints_free)( void* );
+    x264_mb_export_t *mb_export;
 
 #if HAVE_OPENCL
     x264_frame_opencl_t opencl;
 #endif
 } x264_frame_t;
 
-/* synchronized frame list */
+/* synchronized frame list
+ * push and pop wake only one waiter. That is safe because every thread waiting on a
+ * given list would take whichever frame arrives: the lookahead lists have one thread
+ * on each side, the threadpool run list has only idle workers waiting, and a threadpool's
+ * done list (x264_threadpool_wait, which looks for one particular job) has a single
+ * waiter because each pool, including the lookahead pool that also runs the MB-tree
+ * propagate jobs, is only driven from one thread. Anything that waits for a specific
+ * frame from several threads must broadcast instead. */
 typedef struct
 {
    x264_frame_t **list;
@@ -282,6 +305,10 @@ void x264_weight_scale_plane( x264_t *h, pixel *dst, intptr_t i_dst_stride, pixe
                               int i_width, int i_height, x264_weight_t *w );
 #define x264_frame_pop_unused x264_template(frame_pop_unused)
 x264_frame_t *x264_frame_pop_unused( x264_t *h, int b_fdec );
+/* Allocate frames until the unused list holds i_frames, so that they can be recycled
+ * instead of allocated once encoding has started. */
+#define x264_frame_pool_fill x264_template(frame_pool_fill)
+int           x264_frame_pool_fill( x264_t *h, int b_fdec, int i_frames );
 #define x264_frame_delete_list x264_template(frame_delete_list)
 void          x264_frame_delete_list( x264_frame_t **list );
 
@@ -433,6 +433,11 @@ void x264_macroblock_slice_init( x264_t *h )
 
     h->fdec->i_ref[0] = h->i_ref[0];
     h->fdec->i_ref[1] = h->i_ref[1];
+
+    /* Neighbouring intra4x4 modes are only read to predict the modes of an I_4x4 or I_8x8 mb.
+     * cache_save always writes them, so it's safe for this to change between slices. */
+    h->mb.b_load_i4x4_modes = !!((h->sh.i_type == SLICE_TYPE_I ? h->param.analyse.intra : h->param.analyse.inter)
+                                 & (X264_ANALYSE_I4x4|X264_ANALYSE_I8x8));
     for( int i = 0; i < h->i_ref[0]; i++ )
         h->fdec->ref_poc[0][i] = h->fref[0][i]->i_poc;
     if( h->sh.i_type == SLICE_TYPE_B )
@@ -805,7 +810,8 @@ static ALWAYS_INLINE void macroblock_cache_load_neighbours( x264_t *h, int mb_x,
                  * to as part of the previous cache_save.  Since most target CPUs use write-allocate
                  * caches, left blocks are near-guaranteed to be in L1 cache.  Top--not so much. */
                 x264_prefetch( &h->mb.cbp[top] );
-                x264_prefetch( h->mb.intra4x4_pred_mode[top] );
+                if( h->mb.b_load_i4x4_modes )
+                    x264_prefetch( h->mb.intra4x4_pred_mode[top] );
                 x264_prefetch( &h->mb.non_zero_count[top][12] );
                 x264_prefetch( &h->mb.mb_transform_size[top] );
                 if( h->param.b_cabac )
@@ -871,7 +877,8 @@ static ALWAYS_INLINE void macroblock_cache_load( x264_t *h, int mb_x, int mb_y,
     uint8_t (*nnz)[48] = h->mb.non_zero_count;
     int16_t *cbp = h->mb.cbp;
 
-    const x264_left_table_t *left_index_table = h->mb.left_index_table;
+    /* Progressive neighbours always use the same table; a constant lets the compiler fold the left loads. */
+    const x264_left_table_t *left_index_table = b_mbaff ? h->mb.left_index_table : &left_indices[3];
 
     h->mb.cache.deblock_strength = h->deblock_strength[mb_y&1][h->param.b_sliced_threads?h->mb.i_mb_xy:mb_x];
 
@@ -880,7 +887,8 @@ static ALWAYS_INLINE void macroblock_cache_load( x264_t *h, int mb_x, int mb_y,
     {
         h->mb.cache.i_cbp_top = cbp[top];
         /* load intra4x4 */
-        CP32( &h->mb.cache.intra4x4_pred_mode[x264_scan8[0] - 8], &i4x4[top][0] );
+        if( h->mb.b_load_i4x4_modes )
+            CP32( &h->mb.cache.intra4x4_pred_mode[x264_scan8[0] - 8], &i4x4[top][0] );
 
         /* load non_zero_count */
         CP32( &h->mb.cache.non_zero_count[x264_scan8[ 0] - 8], &nnz[top][12] );
@@ -926,10 +934,13 @@ static ALWAYS_INLINE void macroblock_cache_load( x264_t *h, int mb_x, int mb_y,
             h->mb.cache.i_cbp_left = cbp[ltop];
 
         /* load intra4x4 */
-        h->mb.cache.intra4x4_pred_mode[x264_scan8[ 0] - 1] = i4x4[ltop][left_index_table->intra[0]];
-        h->mb.cache.intra4x4_pred_mode[x264_scan8[ 2] - 1] = i4x4[ltop][left_index_table->intra[1]];
-        h->mb.cache.intra4x4_pred_mode[x264_scan8[ 8] - 1] = i4x4[lbot][left_index_table->intra[2]];
-        h->mb.cache.intra4x4_pred_mode[x264_scan8[10] - 1] = i4x4[lbot][left_index_table->intra[3]];
+        if( h->mb.b_load_i4x4_modes )
+        {
+            h->mb.cache.intra4x4_pred_mode[x264_scan8[ 0] - 1] = i4x4[ltop][left_index_table->intra[0]];
+            h->mb.cache.intra4x4_pred_mode[x264_scan8[ 2] - 1] = i4x4[ltop][left_index_table->intra[1]];
+            h->mb.cache.intra4x4_pred_mode[x264_scan8[ 8] - 1] = i4x4[lbot][left_index_table->intra[2]];
+            h->mb.cache.intra4x4_pred_mode[x264_scan8[10] - 1] = i4x4[lbot][left_index_table->intra[3]];
+        }
 
         /* load non_zero_count */
         h->mb.cache.non_zero_count[x264_scan8[ 0] - 1] = nnz[ltop][left_index_table->nnz[0]];
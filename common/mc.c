@@ -458,6 +458,38 @@ static void integral_init8v( uint16_t *sum8, intptr_t stride )
         sum8[x] = (uint16_t)(sum8[x+8*stride] - sum8[x]);
 }
 
+static void frame_init_hme_level( pixel *dst, intptr_t i_dst, pixel *src, intptr_t i_src, int width, int height )
+{
+    for( int y = 0; y < height; y++, dst += i_dst, src += 2*i_src )
+        for( int x = 0; x < width; x++ )
+            dst[x] = (src[2*x] + src[2*x+1] + src[2*x+i_src] + src[2*x+i_src+1] + 2) >> 2;
+}
+
+/* Block luma sums for the scenecut prefilter, one 8x8 lowres block per MB, at the pixel
+ * bit depth (64 pixels of up to 10 bits still fit in 16 bits).
+ * The border has already been expanded, so partial blocks at the edges are fine. */
+static void frame_init_lowres_luma( x264_t *h, x264_frame_t *frame )
+{
+    int i_mb_count = h->mb.i_mb_width * h->mb.i_mb_height;
+    uint16_t *luma = frame->i_lowres_luma;
+    int64_t sum = 0, dev = 0;
+
+    for( int y = 0; y < h->mb.i_mb_height; y++ )
+    {
+        pixel *src = frame->lowres[0] + 8*y*frame->i_stride_lowres;
+        for( int x = 0; x < h->mb.i_mb_width; x++, luma++ )
+        {
+            *luma = (uint32_t)h->pixf.var[PIXEL_8x8]( src + 8*x, frame->i_stride_lowres );
+            sum += *luma;
+        }
+    }
+    int avg = (sum + i_mb_count/2) / i_mb_count;
+    for( int i = 0; i < i_mb_count; i++ )
+        dev += abs( frame->i_lowres_luma[i] - avg );
+    frame->i_lowres_luma_avg = avg;
+    frame->i_lowres_luma_dev = (dev + i_mb_count/2) / i_mb_count;
+}
+
 void x264_frame_init_lowres( x264_t *h, x264_frame_t *frame )
 {
     pixel *src = frame->plane[0];
@@ -471,7 +503,16 @@ void x264_frame_init_lowres( x264_t *h, x264_frame_t *frame )
     memcpy( src+i_stride*i_height, src+i_stride*(i_height-1), (i_width+1) * SIZEOF_PIXEL );
     h->mc.frame_init_lowres_core( src, frame->lowres[0], frame->lowres[1], frame->lowres[2], frame->lowres[3],
                                   i_stride, frame->i_stride_lowres, frame->i_width_lowres, frame->i_lines_lowres );
+    if( frame->lowres_hme[0] )
+    {
+        frame_init_hme_level( frame->lowres_hme[0], frame->i_stride_hme[0], frame->lowres[0], frame->i_stride_lowres,
+                              frame->i_width_hme[0], frame->i_lines_hme[0] );
+        frame_init_hme_level( frame->lowres_hme[1], frame->i_stride_hme[1], frame->lowres_hme[0], frame->i_stride_hme[0],
+                              frame->i_width_hme[1], frame->i_lines_hme[1] );
+    }
     x264_frame_expand_border_lowres( frame );
+    if( frame->i_lowres_luma )
+        frame_init_lowres_luma( h, frame );
 
     memset( frame->i_cost_est, -1, sizeof(frame->i_cost_est) );
 
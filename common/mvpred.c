@@ -544,6 +544,14 @@ void x264_mb_predict_mv_ref16x16( x264_t *h, int i_list, int i_ref, int16_t (*mv
         SET_MVP( h->mb.cache.mv[i_list][x264_scan8[12]] );
     }
 
+    /* caller-supplied hint */
+    if( h->fdec->mb_hints && !SLICE_MBAFF )
+    {
+        x264_mb_hint_t *hint = &h->fdec->mb_hints[h->mb.i_mb_xy];
+        if( hint->i_ref[i_list] == i_ref )
+            SET_MVP( hint->mv[i_list] );
+    }
+
     if( i_ref == 0 && h->frames.b_have_lowres )
     {
         int idx = i_list ? h->fref[1][0]->i_frame-h->fenc->i_frame-1
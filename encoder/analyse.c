@@ -118,8 +118,18 @@ typedef struct
     int b_direct_available;
     int b_early_terminate;
 
+    /* fast decision */
+    int b_fd_prune_split;
+    int b_fd_prune_intra;
+
+    /* caller-supplied hint for this MB, NULL if none */
+    const x264_mb_hint_t *hint;
+
 } x264_mb_analysis_t;
 
+#define HINT_IS_INTER(a) ((a)->hint && (a)->hint->i_partition >= X264_MBHINT_SKIP && (a)->hint->i_partition <= X264_MBHINT_8x8)
+#define HINT_IS_INTRA(a) ((a)->hint && (a)->hint->i_partition >= X264_MBHINT_I16x16 && (a)->hint->i_partition <= X264_MBHINT_I4x4)
+
 /* TODO: calculate CABAC costs */
 static const uint8_t i_mb_b_cost_table[X264_MBTYPE_MAX] =
 {
@@ -138,36 +148,226 @@ static const uint8_t i_sub_mb_p_cost_table[4] =
     5, 3, 3, 1
 };
 
+/* Fast decision: small decision forests that predict, from features which are
+ * nearly free once the 16x16 search is done, whether the sub-16x16 partitions
+ * and the intra modes are worth searching at all.  Each tree is a complete
+ * binary tree of depth 2 and votes a signed score; a class of modes is pruned
+ * when the sum of the votes falls below the threshold picked by --fast-decision.
+ *
+ * The score is 16x the log-odds that the modes win.  The trees were fitted by
+ * gradient boosting on the features and final decisions of --fast-decision 0
+ * encodes (CIF clips, presets fast/medium/slow, crf 20 and 28, P and B frames
+ * together).  The thresholds are the scores below which 1%, 3% and 6% of the
+ * MBs that did pick the modes fall; on held-out clips that prunes the split
+ * search in 35-50% and the intra search in 45-75% of the analysed MBs. */
+enum
+{
+    FD_COST16x16, /* best 16x16 inter cost, in units of lambda */
+    FD_COSTMV,    /* mv+ref cost of that 16x16 mode, in units of lambda */
+    FD_VAR,       /* luma AC energy per pixel, same measure as AQ */
+    FD_LOWRES,    /* lookahead inter/intra cost ratio of this MB, *16 */
+    FD_NB_SPLIT,  /* neighbours coded with partitions smaller than 16x16 */
+    FD_NB_INTRA,  /* intra neighbours */
+    FD_NB_SKIP,   /* skipped neighbours */
+    FD_FEATURES
+};
+
+typedef struct
+{
+    uint8_t feature[3]; /* root, then the two inner nodes */
+    int16_t thresh[3];  /* go right if feature >= thresh */
+    int8_t  vote[4];
+} x264_fd_tree_t;
+
+/* Predict whether anything smaller than 16x16 can beat 16x16. */
+static const x264_fd_tree_t fd_forest_split[4] =
+{
+    { { FD_COST16x16, FD_COSTMV,   FD_NB_SPLIT  }, { 287, 10,   2 }, { -31, -21, -16, -3 } },
+    { { FD_COST16x16, FD_COSTMV,   FD_LOWRES    }, { 226,  6,   2 }, {  -8,   0,  -1,  7 } },
+    { { FD_COST16x16, FD_COSTMV,   FD_NB_INTRA  }, { 164, 15,   1 }, {  -8,  15,   3, -5 } },
+    { { FD_LOWRES,    FD_COSTMV,   FD_COST16x16 }, {   3,  2, 856 }, {  -8,  -1,   6, -2 } },
+};
+
+/* Predict whether an intra mode can beat the best inter mode. */
+static const x264_fd_tree_t fd_forest_intra[4] =
+{
+    { { FD_NB_INTRA,  FD_LOWRES,    FD_LOWRES    }, {   1,  15,   14 }, { -49, -26, -17, 29 } },
+    { { FD_NB_INTRA,  FD_COST16x16, FD_LOWRES    }, {   4, 739,   14 }, {  -8,  -3,  15,  2 } },
+    { { FD_COSTMV,    FD_VAR,       FD_COST16x16 }, {   8, 159, 1290 }, {  -5,  -8,  -4,  3 } },
+    { { FD_COSTMV,    FD_NB_INTRA,  FD_LOWRES    }, {   4,   1,   14 }, {  -7, -10,   2, -4 } },
+};
+
+/* Indexed by --fast-decision; prune when the forest's score is below this. */
+static const int8_t fd_thresh_split[4] = { INT8_MIN, -44, -30, -20 };
+static const int8_t fd_thresh_intra[4] = { INT8_MIN, -69, -59, -54 };
+
+static int fd_forest_eval( const x264_fd_tree_t *forest, int trees, const int *x )
+{
+    int score = 0;
+    for( int i = 0; i < trees; i++ )
+    {
+        const x264_fd_tree_t *t = &forest[i];
+        int l = x[t->feature[0]] >= t->thresh[0];
+        int r = x[t->feature[1+l]] >= t->thresh[1+l];
+        score += t->vote[2*l+r];
+    }
+    return score;
+}
+
+static void mb_analyse_fast_decision( x264_t *h, x264_mb_analysis_t *a, int i_cost16x16, int i_cost_mv )
+{
+    int x[FD_FEATURES];
+    int lambda = a->i_lambda;
+    int mb_xy = h->mb.i_mb_xy;
+    x264_frame_t *fenc = h->fenc;
+
+    x[FD_COST16x16] = i_cost16x16 / lambda;
+    x[FD_COSTMV] = i_cost_mv / lambda;
+
+    uint64_t sum_ssd = h->pixf.var[PIXEL_16x16]( h->mb.pic.p_fenc[0], FENC_STRIDE );
+    uint32_t sum = sum_ssd;
+    uint32_t ssd = sum_ssd >> 32;
+    x[FD_VAR] = (ssd - ((uint64_t)sum * sum >> 8)) >> (8 + 2*(BIT_DEPTH-8));
+
+    /* Default to "inter is as expensive as intra", which never prunes on its own. */
+    x[FD_LOWRES] = 16;
+    if( h->frames.b_have_lowres && fenc->i_cost_est[0][0] >= 0 )
+    {
+        int d0 = fenc->i_frame - h->fref[0][0]->i_frame;
+        int d1 = h->sh.i_type == SLICE_TYPE_B ? h->fref[1][0]->i_frame - fenc->i_frame : 0;
+        if( d0 > 0 && d0 <= X264_BFRAME_MAX+1 && d1 >= 0 && d1 <= X264_BFRAME_MAX+1 && fenc->i_cost_est[d0][d1] >= 0 )
+        {
+            int inter = fenc->lowres_costs[d0][d1][mb_xy] & LOWRES_COST_MASK;
+            int intra = fenc->i_intra_cost[mb_xy];
+            x[FD_LOWRES] = X264_MIN( inter * 16 / (intra + 1), 64 );
+        }
+    }
+
+    x[FD_NB_SPLIT] = x[FD_NB_INTRA] = x[FD_NB_SKIP] = 0;
+    int nb_type[4] = { h->mb.i_mb_type_left[0], h->mb.i_mb_type_top, h->mb.i_mb_type_topleft, h->mb.i_mb_type_topright };
+    int nb_xy[4] = { h->mb.i_mb_left_xy[0], h->mb.i_mb_top_xy, h->mb.i_mb_topleft_xy, h->mb.i_mb_topright_xy };
+    for( int i = 0; i < 4; i++ )
+    {
+        if( nb_type[i] < 0 )
+            continue;
+        if( IS_INTRA( nb_type[i] ) )
+            x[FD_NB_INTRA]++;
+        else if( IS_SKIP( nb_type[i] ) )
+            x[FD_NB_SKIP]++;
+        else if( h->mb.partition[nb_xy[i]] != D_16x16 )
+            x[FD_NB_SPLIT]++;
+    }
+
+    int level = h->param.analyse.i_fast_decision;
+    a->b_fd_prune_split = fd_forest_eval( fd_forest_split, ARRAY_ELEMS(fd_forest_split), x ) < fd_thresh_split[level];
+    a->b_fd_prune_intra = fd_forest_eval( fd_forest_intra, ARRAY_ELEMS(fd_forest_intra), x ) < fd_thresh_intra[level];
+}
+
+/* Sub-16x16 partitions ruled out by fast decision or by the caller's hint. */
+static unsigned int mb_analyse_p_pruned( x264_mb_analysis_t *a )
+{
+    if( a->b_fd_prune_split || HINT_IS_INTRA( a ) || (HINT_IS_INTER( a ) && a->hint->i_partition <= X264_MBHINT_16x16) )
+        return X264_ANALYSE_PSUB16x16|X264_ANALYSE_PSUB8x8;
+    if( HINT_IS_INTER( a ) && a->hint->i_partition != X264_MBHINT_8x8 )
+        return X264_ANALYSE_PSUB8x8;
+    return 0;
+}
+
+static unsigned int mb_analyse_b_pruned( x264_mb_analysis_t *a )
+{
+    if( a->b_fd_prune_split || HINT_IS_INTRA( a ) || (HINT_IS_INTER( a ) && a->hint->i_partition <= X264_MBHINT_16x16) )
+        return X264_ANALYSE_BSUB16x16;
+    return 0;
+}
+
+/* mv+ref cost of the best 16x16 B mode, the counterpart of the P16x16 search's for fast decision. */
+static int mb_analyse_b16x16_cost_mv( x264_mb_analysis_t *a, int i_type )
+{
+    switch( i_type )
+    {
+        case B_L0_L0:
+            return a->l0.me16x16.cost_mv + a->l0.me16x16.i_ref_cost;
+        case B_L1_L1:
+            return a->l1.me16x16.cost_mv + a->l1.me16x16.i_ref_cost;
+        case B_BI_BI:
+            return a->l0.bi16x16.cost_mv + a->l0.bi16x16.i_ref_cost
+                 + a->l1.bi16x16.cost_mv + a->l1.bi16x16.i_ref_cost;
+        default: /* direct: no mvs or refs are coded */
+            return 0;
+    }
+}
+
 static void analyse_update_cache( x264_t *h, x264_mb_analysis_t *a );
 
-static int init_costs( x264_t *h, float *logs, int qp )
+/* The mv cost tables only depend on the qp and the mv range, so rather than having
+ * every x264_encoder_open rebuild them, they are kept in a process-wide list shared by
+ * all encoders with the same range.  Tables are filled in under the lock and never
+ * modified afterwards, so encoders can read them without synchronization. */
+typedef struct x264_mv_costs_t
 {
-    if( h->cost_mv[qp] )
-        return 0;
+    struct x264_mv_costs_t *next;
+    int mv_range;
+    int refcount;
+    uint16_t *cost_mv[QP_MAX+1];
+    uint16_t *cost_mv_fpel[QP_MAX+1][4];
+} x264_mv_costs_t;
+
+static x264_mv_costs_t *mv_costs_list;
+#if HAVE_THREAD
+static x264_pthread_mutex_t mv_costs_mutex = X264_PTHREAD_MUTEX_INITIALIZER;
+#endif
 
-    int mv_range = h->param.analyse.i_mv_range << PARAM_INTERLACED;
+static float *init_cost_logs( int mv_range )
+{
+    float *logs = x264_malloc( (2*4*mv_range+1) * sizeof(float) );
+    if( !logs )
+        return NULL;
+
+    logs[0] = 0.718f;
+    for( int i = 1; i <= 2*4*mv_range; i++ )
+        logs[i] = log2f( i+1 ) * 2.0f + 1.718f;
+    return logs;
+}
+
+static int init_costs( x264_t *h, float **logs, int qp )
+{
+    x264_mv_costs_t *c = h->mv_costs;
+    int mv_range = c->mv_range;
     int lambda = x264_lambda_tab[qp];
-    /* factor of 4 from qpel, 2 from sign, and 2 because mv can be opposite from mvp */
-    CHECKED_MALLOC( h->cost_mv[qp], (4*4*mv_range + 1) * sizeof(uint16_t) );
-    h->cost_mv[qp] += 2*4*mv_range;
-    for( int i = 0; i <= 2*4*mv_range; i++ )
+    if( !c->cost_mv[qp] )
     {
-        h->cost_mv[qp][-i] =
-        h->cost_mv[qp][i]  = X264_MIN( (int)(lambda * logs[i] + .5f), UINT16_MAX );
+        if( !*logs && !(*logs = init_cost_logs( mv_range )) )
+            return -1;
+        /* factor of 4 from qpel, 2 from sign, and 2 because mv can be opposite from mvp */
+        CHECKED_MALLOC( c->cost_mv[qp], (4*4*mv_range + 1) * sizeof(uint16_t) );
+        c->cost_mv[qp] += 2*4*mv_range;
+        for( int i = 0; i <= 2*4*mv_range; i++ )
+        {
+            c->cost_mv[qp][-i] =
+            c->cost_mv[qp][i]  = X264_MIN( (int)(lambda * (*logs)[i] + .5f), UINT16_MAX );
+        }
     }
+    h->cost_mv[qp] = c->cost_mv[qp];
     for( int i = 0; i < 3; i++ )
         for( int j = 0; j < 33; j++ )
             h->cost_table->ref[qp][i][j] = i ? X264_MIN( lambda * bs_size_te( i, j ), UINT16_MAX ) : 0;
-    if( h->param.analyse.i_me_method >= X264_ME_ESA && !h->cost_mv_fpel[qp][0] )
+    if( h->param.analyse.i_me_method >= X264_ME_ESA )
     {
+        /* Each table is checked on its own: an earlier encoder may have failed part way through. */
         for( int j = 0; j < 4; j++ )
         {
-            CHECKED_MALLOC( h->cost_mv_fpel[qp][j], (4*mv_range + 1) * sizeof(uint16_t) );
-            h->cost_mv_fpel[qp][j] += 2*mv_range;
+            if( c->cost_mv_fpel[qp][j] )
+                continue;
+            uint16_t *cost_mv_fpel;
+            CHECKED_MALLOC( cost_mv_fpel, (4*mv_range + 1) * sizeof(uint16_t) );
+            cost_mv_fpel += 2*mv_range;
             for( int i = -2*mv_range; i < 2*mv_range; i++ )
-                h->cost_mv_fpel[qp][j][i] = h->cost_mv[qp][i*4+j];
+                cost_mv_fpel[i] = c->cost_mv[qp][i*4+j];
+            c->cost_mv_fpel[qp][j] = cost_mv_fpel;
         }
     }
+    for( int j = 0; j < 4; j++ )
+        h->cost_mv_fpel[qp][j] = c->cost_mv_fpel[qp][j];
     uint16_t *cost_i4x4_mode = h->cost_table->i4x4_mode[qp];
     for( int i = 0; i < 17; i++ )
         cost_i4x4_mode[i] = 3*lambda*(i!=8);
@@ -179,41 +379,66 @@ fail:
 int x264_analyse_init_costs( x264_t *h )
 {
     int mv_range = h->param.analyse.i_mv_range << PARAM_INTERLACED;
-    float *logs = x264_malloc( (2*4*mv_range+1) * sizeof(float) );
-    if( !logs )
-        return -1;
+    float *logs = NULL;
+    int ret = -1;
 
-    logs[0] = 0.718f;
-    for( int i = 1; i <= 2*4*mv_range; i++ )
-        logs[i] = log2f( i+1 ) * 2.0f + 1.718f;
+    x264_pthread_mutex_lock( &mv_costs_mutex );
+
+    x264_mv_costs_t *c = mv_costs_list;
+    while( c && c->mv_range != mv_range )
+        c = c->next;
+    if( !c )
+    {
+        CHECKED_MALLOCZERO( c, sizeof(x264_mv_costs_t) );
+        c->mv_range = mv_range;
+        c->next = mv_costs_list;
+        mv_costs_list = c;
+    }
+    c->refcount++;
+    h->mv_costs = c;
 
     for( int qp = X264_MIN( h->param.rc.i_qp_min, QP_MAX_SPEC ); qp <= h->param.rc.i_qp_max; qp++ )
-        if( init_costs( h, logs, qp ) )
+        if( init_costs( h, &logs, qp ) )
             goto fail;
 
-    if( init_costs( h, logs, X264_LOOKAHEAD_QP ) )
+    if( init_costs( h, &logs, X264_LOOKAHEAD_QP ) )
         goto fail;
 
-    x264_free( logs );
-    return 0;
+    ret = 0;
 fail:
+    x264_pthread_mutex_unlock( &mv_costs_mutex );
     x264_free( logs );
-    return -1;
+    return ret;
 }
 
 void x264_analyse_free_costs( x264_t *h )
 {
-    int mv_range = h->param.analyse.i_mv_range << PARAM_INTERLACED;
-    for( int i = 0; i < QP_MAX+1; i++ )
+    x264_mv_costs_t *c = h->mv_costs;
+    if( !c )
+        return;
+
+    x264_pthread_mutex_lock( &mv_costs_mutex );
+    if( !--c->refcount )
     {
-        if( h->cost_mv[i] )
-            x264_free( h->cost_mv[i] - 2*4*mv_range );
-        for( int j = 0; j < 4; j++ )
+        x264_mv_costs_t **prev = &mv_costs_list;
+        while( *prev != c )
+            prev = &(*prev)->next;
+        *prev = c->next;
+
+        for( int i = 0; i < QP_MAX+1; i++ )
         {
-            if( h->cost_mv_fpel[i][j] )
-                x264_free( h->cost_mv_fpel[i][j] - 2*mv_range );
+            if( c->cost_mv[i] )
+                x264_free( c->cost_mv[i] - 2*4*c->mv_range );
+            for( int j = 0; j < 4; j++ )
+            {
+                if( c->cost_mv_fpel[i][j] )
+                    x264_free( c->cost_mv_fpel[i][j] - 2*c->mv_range );
+            }
         }
+        x264_free( c );
     }
+    x264_pthread_mutex_unlock( &mv_costs_mutex );
+    h->mv_costs = NULL;
 }
 
 void x264_analyse_weight_frame( x264_t *h, int end )
@@ -319,6 +544,9 @@ static void mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
 
     a->b_fast_intra = 0;
     a->b_avoid_topright = 0;
+    a->b_fd_prune_split = 0;
+    a->b_fd_prune_intra = 0;
+    a->hint = h->fdec->mb_hints && !SLICE_MBAFF ? &h->fdec->mb_hints[h->mb.i_mb_xy] : NULL;
     h->mb.i_skip_intra =
         h->mb.b_lossless ? 0 :
         a->i_mbrd ? 2 :
@@ -668,7 +896,9 @@ static void mb_analyse_intra_chroma( x264_t *h, x264_mb_analysis_t *a )
 // 宏块帧内预测：对亮度而言，一个16x16的块，要么划分为16个4x4的小块，要么不划分；不存在其他划分情况
 static void mb_analyse_intra( x264_t *h, x264_mb_analysis_t *a, int i_satd_inter )
 {
-    const unsigned int flags = h->sh.i_type == SLICE_TYPE_I ? h->param.analyse.intra : h->param.analyse.inter;
+    unsigned int flags = h->sh.i_type == SLICE_TYPE_I ? h->param.analyse.intra : h->param.analyse.inter;
+    int b_hint_i16x16 = a->hint && a->hint->i_partition == X264_MBHINT_I16x16;
+    int i_hint_mode = b_hint_i16x16 ? a->hint->i_intra_mode : -1;
     pixel *p_src = h->mb.pic.p_fenc[0];  // 源数据，此处是要编码数据
     pixel *p_dst = h->mb.pic.p_fdec[0];  // 重构数据，此处是被参考数据
     static const int8_t intra_analysis_shortcut[2][2][2][5] =
@@ -686,6 +916,10 @@ static void mb_analyse_intra( x264_t *h, x264_mb_analysis_t *a, int i_satd_inter
     int idx;
     int lambda = a->i_lambda;
 
+    /* A hinted I16x16 MB doesn't need the smaller intra partitions. */
+    if( b_hint_i16x16 && !h->param.i_avcintra_class )
+        flags &= ~(X264_ANALYSE_I4x4|X264_ANALYSE_I8x8);
+
     /*---------------- Try all mode and calculate their score ---------------*/
     /* Disabled i16x16 for AVC-Intra compat */
     // 16x16帧内预测选择，此时宏块不需要进行划分。16x16最多4种预测模式可用
@@ -717,9 +951,10 @@ static void mb_analyse_intra( x264_t *h, x264_mb_analysis_t *a, int i_satd_inter
             COPY2_IF_LT( a->i_satd_i16x16, a->i_satd_i16x16_dir[1], a->i_predict16x16, 1 );
             COPY2_IF_LT( a->i_satd_i16x16, a->i_satd_i16x16_dir[2], a->i_predict16x16, 2 );
 
-            /* Plane is expensive, so don't check it unless one of the previous modes was useful. */
+            /* Plane is expensive, so don't check it unless one of the previous modes was useful
+             * or the hint asks for it. */
             // 只有当上面的最优预测模式比阈值小，才进行Plane预测模式分析
-            if( a->i_satd_i16x16 <= i16x16_thresh )
+            if( i_hint_mode == I_PRED_16x16_P || (i_hint_mode < 0 && a->i_satd_i16x16 <= i16x16_thresh) )
             {
                 h->predict_16x16[I_PRED_16x16_P]( p_dst );
                 a->i_satd_i16x16_dir[I_PRED_16x16_P] = h->pixf.mbcmp[PIXEL_16x16]( p_src, FENC_STRIDE, p_dst, FDEC_STRIDE );
@@ -1275,7 +1510,7 @@ static void mb_analyse_inter_p16x16( x264_t *h, x264_mb_analysis_t *a )
     // 运动估计相关的信息
     x264_me_t m;
     int i_mvc;
-    ALIGNED_ARRAY_8( int16_t, mvc,[8],[2] );
+    ALIGNED_ARRAY_8( int16_t, mvc,[9],[2] );
     int i_halfpel_thresh = INT_MAX;
     int *p_halfpel_thresh = (a->b_early_terminate && h->mb.pic.i_fref[0]>1) ? &i_halfpel_thresh : NULL;
 
@@ -1917,7 +2152,7 @@ static void mb_analyse_inter_b16x16( x264_t *h, x264_mb_analysis_t *a )
     pixel *src0, *src1;
     intptr_t stride0 = 16, stride1 = 16;
     int i_ref, i_mvc;
-    ALIGNED_ARRAY_8( int16_t, mvc,[9],[2] );
+    ALIGNED_ARRAY_8( int16_t, mvc,[10],[2] );
     int try_skip = a->b_try_skip;
     int list1_skipped = 0;
     int i_halfpel_thresh[2] = {INT_MAX, INT_MAX};
@@ -3054,6 +3289,9 @@ intra_analysis:
                          h->mb.i_mb_type_topright == P_SKIP )
                     b_skip = x264_macroblock_probe_pskip( h );  // 检查是否时SKIP类型
             }
+            /* A hinted P_SKIP is worth probing before any motion search. */
+            if( !b_skip && !skip_invalid && analysis.hint && analysis.hint->i_partition == X264_MBHINT_SKIP )
+                b_skip = x264_macroblock_probe_pskip( h );
         }
 
         h->mc.prefetch_ref( h->mb.pic.p_fref[0][0][h->mb.i_mb_x&3], h->mb.pic.i_stride[0], 1 );
@@ -3070,7 +3308,6 @@ skip_analysis:
         }
         else  // 帧间预测（包含了帧内预测分析）
         {
-            const unsigned int flags = h->param.analyse.inter;
             int i_type;                     // 宏块类型
             int i_partition;                // 宏块预测模式
             int i_satd_inter, i_satd_intra;
@@ -3086,6 +3323,12 @@ skip_analysis:
                 return;
             }
 
+            if( h->param.analyse.i_fast_decision && analysis.b_early_terminate && !analysis.b_force_intra )
+                mb_analyse_fast_decision( h, &analysis, analysis.l0.me16x16.cost,
+                                          analysis.l0.me16x16.cost_mv + analysis.l0.me16x16.i_ref_cost );
+
+            const unsigned int flags = h->param.analyse.inter & ~mb_analyse_p_pruned( &analysis );
+
             if( flags & X264_ANALYSE_PSUB16x16 )
             {
                 if( h->param.analyse.b_mixed_references )
@@ -3226,24 +3469,28 @@ skip_analysis:
                 }
             }
 
-            if( h->mb.b_chroma_me )
+            /* When intra is unlikely, its costs are left at COST_MAX. */
+            if( !analysis.b_fd_prune_intra && !(HINT_IS_INTER( &analysis ) && !analysis.b_force_intra) )
             {
-                if( CHROMA444 )
+                if( h->mb.b_chroma_me )
                 {
-                    mb_analyse_intra( h, &analysis, i_cost );
-                    mb_analyse_intra_chroma( h, &analysis );
+                    if( CHROMA444 )
+                    {
+                        mb_analyse_intra( h, &analysis, i_cost );
+                        mb_analyse_intra_chroma( h, &analysis );
+                    }
+                    else
+                    {
+                        mb_analyse_intra_chroma( h, &analysis );
+                        mb_analyse_intra( h, &analysis, i_cost - analysis.i_satd_chroma );
+                    }
+                    analysis.i_satd_i16x16 += analysis.i_satd_chroma;
+                    analysis.i_satd_i8x8   += analysis.i_satd_chroma;
+                    analysis.i_satd_i4x4   += analysis.i_satd_chroma;
                 }
                 else
-                {
-                    mb_analyse_intra_chroma( h, &analysis );
-                    mb_analyse_intra( h, &analysis, i_cost - analysis.i_satd_chroma );
-                }
-                analysis.i_satd_i16x16 += analysis.i_satd_chroma;
-                analysis.i_satd_i8x8   += analysis.i_satd_chroma;
-                analysis.i_satd_i4x4   += analysis.i_satd_chroma;
+                    mb_analyse_intra( h, &analysis, i_cost );
             }
-            else
-                mb_analyse_intra( h, &analysis, i_cost );
 
             i_satd_inter = i_cost;
             i_satd_intra = X264_MIN3( analysis.i_satd_i16x16,
@@ -3417,7 +3664,6 @@ skip_analysis:
 
         if( !b_skip )
         {
-            const unsigned int flags = h->param.analyse.inter;
             int i_type;
             int i_partition;
             int i_satd_inter;
@@ -3449,6 +3695,11 @@ skip_analysis:
             COPY2_IF_LT( i_cost, analysis.i_cost16x16bi, i_type, B_BI_BI );
             COPY2_IF_LT( i_cost, analysis.i_cost16x16direct, i_type, B_DIRECT );
 
+            if( h->param.analyse.i_fast_decision && analysis.b_early_terminate )
+                mb_analyse_fast_decision( h, &analysis, i_cost, mb_analyse_b16x16_cost_mv( &analysis, i_type ) );
+
+            const unsigned int flags = h->param.analyse.inter & ~mb_analyse_b_pruned( &analysis );
+
             if( analysis.i_mbrd && analysis.b_early_terminate && analysis.i_cost16x16direct <= i_cost * 33/32 )
             {
                 mb_analyse_b_rd( h, &analysis, i_cost );
@@ -3636,24 +3887,28 @@ skip_analysis:
                 h->mb.i_partition = i_partition;
             }
 
-            if( h->mb.b_chroma_me )
+            /* When intra is unlikely, its costs are left at COST_MAX. */
+            if( !analysis.b_fd_prune_intra && !HINT_IS_INTER( &analysis ) )
             {
-                if( CHROMA444 )
+                if( h->mb.b_chroma_me )
                 {
-                    mb_analyse_intra( h, &analysis, i_satd_inter );
-                    mb_analyse_intra_chroma( h, &analysis );
+                    if( CHROMA444 )
+                    {
+                        mb_analyse_intra( h, &analysis, i_satd_inter );
+                        mb_analyse_intra_chroma( h, &analysis );
+                    }
+                    else
+                    {
+                        mb_analyse_intra_chroma( h, &analysis );
+                        mb_analyse_intra( h, &analysis, i_satd_inter - analysis.i_satd_chroma );
+                    }
+                    analysis.i_satd_i16x16 += analysis.i_satd_chroma;
+                    analysis.i_satd_i8x8   += analysis.i_satd_chroma;
+                    analysis.i_satd_i4x4   += analysis.i_satd_chroma;
                 }
                 else
-                {
-                    mb_analyse_intra_chroma( h, &analysis );
-                    mb_analyse_intra( h, &analysis, i_satd_inter - analysis.i_satd_chroma );
-                }
-                analysis.i_satd_i16x16 += analysis.i_satd_chroma;
-                analysis.i_satd_i8x8   += analysis.i_satd_chroma;
-                analysis.i_satd_i4x4   += analysis.i_satd_chroma;
+                    mb_analyse_intra( h, &analysis, i_satd_inter );
             }
-            else
-                mb_analyse_intra( h, &analysis, i_satd_inter );
 
             if( analysis.i_mbrd )
             {
@@ -51,5 +51,7 @@ void x264_lookahead_put_frame( x264_t *h, x264_frame_t *frame );
 void x264_lookahead_get_frames( x264_t *h );
 #define x264_lookahead_delete x264_template(lookahead_delete)
 void x264_lookahead_delete( x264_t *h );
+#define x264_lookahead_reset x264_template(lookahead_reset)
+int  x264_lookahead_reset( x264_t *h );
 
 #endif
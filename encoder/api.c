@@ -42,6 +42,8 @@ int  x264_8_encoder_delayed_frames( x264_t * );
 int  x264_8_encoder_maximum_delayed_frames( x264_t * );
 void x264_8_encoder_intra_refresh( x264_t * );
 int  x264_8_encoder_invalidate_reference( x264_t *, int64_t pts );
+int  x264_8_encoder_reset( x264_t *, x264_param_t * );
+void x264_8_encoder_frame_pool_stats( x264_t *, x264_frame_pool_stats_t * );
 
 x264_t *x264_10_encoder_open( x264_param_t *, void * );
 void x264_10_nal_encode( x264_t *h, uint8_t *dst, x264_nal_t *nal );
@@ -54,6 +56,8 @@ int  x264_10_encoder_delayed_frames( x264_t * );
 int  x264_10_encoder_maximum_delayed_frames( x264_t * );
 void x264_10_encoder_intra_refresh( x264_t * );
 int  x264_10_encoder_invalidate_reference( x264_t *, int64_t pts );
+int  x264_10_encoder_reset( x264_t *, x264_param_t * );
+void x264_10_encoder_frame_pool_stats( x264_t *, x264_frame_pool_stats_t * );
 
 typedef struct x264_api_t
 {
@@ -71,6 +75,8 @@ typedef struct x264_api_t
     int  (*encoder_maximum_delayed_frames)( x264_t * );
     void (*encoder_intra_refresh)( x264_t * );
     int  (*encoder_invalidate_reference)( x264_t *, int64_t pts );
+    int  (*encoder_reset)( x264_t *, x264_param_t * );
+    void (*encoder_frame_pool_stats)( x264_t *, x264_frame_pool_stats_t * );
 } x264_api_t;
 
 REALIGN_STACK x264_t *x264_encoder_open( x264_param_t *param )
@@ -91,6 +97,8 @@ REALIGN_STACK x264_t *x264_encoder_open( x264_param_t *param )
         api->encoder_maximum_delayed_frames = x264_8_encoder_maximum_delayed_frames;
         api->encoder_intra_refresh = x264_8_encoder_intra_refresh;
         api->encoder_invalidate_reference = x264_8_encoder_invalidate_reference;
+        api->encoder_reset = x264_8_encoder_reset;
+        api->encoder_frame_pool_stats = x264_8_encoder_frame_pool_stats;
 
         api->x264 = x264_8_encoder_open( param, api );
     }
@@ -106,6 +114,8 @@ REALIGN_STACK x264_t *x264_encoder_open( x264_param_t *param )
         api->encoder_maximum_delayed_frames = x264_10_encoder_maximum_delayed_frames;
         api->encoder_intra_refresh = x264_10_encoder_intra_refresh;
         api->encoder_invalidate_reference = x264_10_encoder_invalidate_reference;
+        api->encoder_reset = x264_10_encoder_reset;
+        api->encoder_frame_pool_stats = x264_10_encoder_frame_pool_stats;
 
         api->x264 = x264_10_encoder_open( param, api );
     }
@@ -192,3 +202,17 @@ REALIGN_STACK int x264_encoder_invalidate_reference( x264_t *h, int64_t pts )
 
     return api->encoder_invalidate_reference( api->x264, pts );
 }
+
+REALIGN_STACK int x264_encoder_reset( x264_t *h, x264_param_t *param )
+{
+    x264_api_t *api = (x264_api_t *)h;
+
+    return api->encoder_reset( api->x264, param );
+}
+
+REALIGN_STACK void x264_encoder_frame_pool_stats( x264_t *h, x264_frame_pool_stats_t *stats )
+{
+    x264_api_t *api = (x264_api_t *)h;
+
+    api->encoder_frame_pool_stats( api->x264, stats );
+}
@@ -32,6 +32,8 @@
 #include "ratecontrol.h"
 #include "macroblock.h"
 #include "me.h"
+#include "speed.h"
+#include "common/autotune.h"
 #if HAVE_INTEL_DISPATCHER
 #include "extras/intel_dispatcher.h"
 #endif
@@ -582,6 +584,8 @@ static int validate_parameters( x264_t *h, int b_open )
         h->param.b_sliced_threads = 0;
         h->param.i_lookahead_threads = 1;
     }
+    if( !h->param.b_sliced_threads )
+        h->param.b_sliced_threads_balance = 0;
     h->i_thread_frames = h->param.b_sliced_threads ? 1 : h->param.i_threads;
     if( h->i_thread_frames > 1 )
         h->param.nalu_process = NULL;
@@ -821,6 +825,12 @@ static int validate_parameters( x264_t *h, int b_open )
             return -1;
         }
 
+        if( h->param.nal_buffer_get )
+        {
+            x264_log( h, X264_LOG_ERROR, "nal_buffer_get is not supported in AVC-Intra mode\n" );
+            return -1;
+        }
+
         if( !h->param.b_repeat_headers )
         {
             x264_log( h, X264_LOG_ERROR, "Separate headers not supported in AVC-Intra mode\n" );
@@ -874,6 +884,8 @@ static int validate_parameters( x264_t *h, int b_open )
         memcpy( h->param.cqm_4iy, avcintra_lut[type][res][i].cqm_4iy, sizeof(h->param.cqm_4iy) );
         memcpy( h->param.cqm_4ic, avcintra_lut[type][res][i].cqm_4ic, sizeof(h->param.cqm_4ic) );
         memcpy( h->param.cqm_8iy, avcintra_lut[type][res][i].cqm_8iy, sizeof(h->param.cqm_8iy) );
+        h->param.i_slice_first_rows = 0;
+        h->param.b_sliced_threads_balance = 0;
 
         /* Sony XAVC flavor much more simple */
         if( h->param.i_avcintra_flavor == X264_AVCINTRA_FLAVOR_SONY )
@@ -1033,12 +1045,19 @@ static int validate_parameters( x264_t *h, int b_open )
     }
 
     int max_slices = (h->param.i_height+((16<<PARAM_INTERLACED)-1))/(16<<PARAM_INTERLACED);
+    h->param.i_slice_first_rows = x264_clip3( h->param.i_slice_first_rows, 0, (h->param.i_height+15)/16 );
+    if( h->param.i_slice_first_rows )
+    {
+        /* Slices end on a row boundary, which in MBAFF means a row of MB pairs. */
+        h->param.i_slice_first_rows += h->param.i_slice_first_rows & PARAM_INTERLACED;
+        h->param.i_slice_max_mbs = 0;
+    }
     if( h->param.b_sliced_threads )
         h->param.i_slice_count = x264_clip3( h->param.i_threads, 0, max_slices );
     else
     {
         h->param.i_slice_count = x264_clip3( h->param.i_slice_count, 0, max_slices );
-        if( h->param.i_slice_max_mbs || h->param.i_slice_max_size )
+        if( h->param.i_slice_max_mbs || h->param.i_slice_max_size || h->param.i_slice_first_rows )
             h->param.i_slice_count = 0;
     }
     if( h->param.i_slice_count_max > 0 )
@@ -1052,6 +1071,7 @@ static int validate_parameters( x264_t *h, int b_open )
         h->param.i_nal_hrd = X264_MAX( h->param.i_nal_hrd, X264_NAL_HRD_VBR );
         h->param.i_slice_max_size = 0;
         h->param.i_slice_max_mbs = 0;
+        h->param.i_slice_first_rows = 0;
         h->param.b_intra_refresh = 0;
         h->param.i_frame_reference = X264_MIN( h->param.i_frame_reference, 6 );
         h->param.i_dpb_size = X264_MIN( h->param.i_dpb_size, 6 );
@@ -1067,6 +1087,8 @@ static int validate_parameters( x264_t *h, int b_open )
     h->param.i_dpb_size = x264_clip3( h->param.i_dpb_size, 1, X264_REF_MAX );
     if( h->param.i_scenecut_threshold < 0 )
         h->param.i_scenecut_threshold = 0;
+    if( !h->param.i_scenecut_threshold )
+        h->param.b_scenecut_prefilter = 0;
     h->param.analyse.i_direct_mv_pred = x264_clip3( h->param.analyse.i_direct_mv_pred, X264_DIRECT_PRED_NONE, X264_DIRECT_PRED_AUTO );
     if( !h->param.analyse.i_subpel_refine && h->param.analyse.i_direct_mv_pred > X264_DIRECT_PRED_SPATIAL )
     {
@@ -1133,17 +1155,24 @@ static int validate_parameters( x264_t *h, int b_open )
         x264_log( h, X264_LOG_WARNING, "lookaheadless mb-tree requires intra refresh or infinite keyint\n" );
         h->param.rc.b_mb_tree = 0;
     }
-    if( b_open && h->param.rc.b_stat_read )
+    if( b_open && (h->param.rc.b_stat_read || h->param.rc.psz_lookahead_in) )
         h->param.rc.i_lookahead = 0;
+    if( !h->param.rc.b_mb_tree || !h->param.rc.i_lookahead )
+        h->param.rc.b_mb_tree_incremental = 0;
 #if HAVE_THREAD
     if( h->param.i_sync_lookahead < 0 )
         h->param.i_sync_lookahead = h->param.i_bframe + 1;
     h->param.i_sync_lookahead = X264_MIN( h->param.i_sync_lookahead, X264_LOOKAHEAD_MAX );
-    if( h->param.rc.b_stat_read || h->i_thread_frames == 1 )
+    if( h->param.rc.b_stat_read || h->param.rc.psz_lookahead_in || h->i_thread_frames == 1 )
         h->param.i_sync_lookahead = 0;
 #else
     h->param.i_sync_lookahead = 0;
 #endif
+    if( b_open )
+    {
+        h->param.sc.f_speed = x264_clip3f( h->param.sc.f_speed, 0, 100 );
+        h->param.sc.i_buffer_size = x264_clip3( h->param.sc.i_buffer_size, 1, 1000 );
+    }
 
     h->param.i_deblocking_filter_alphac0 = x264_clip3( h->param.i_deblocking_filter_alphac0, -6, 6 );
     h->param.i_deblocking_filter_beta    = x264_clip3( h->param.i_deblocking_filter_beta, -6, 6 );
@@ -1238,6 +1267,7 @@ static int validate_parameters( x264_t *h, int b_open )
         h->param.rc.f_aq_strength = 0;
     }
     h->param.analyse.i_noise_reduction = x264_clip3( h->param.analyse.i_noise_reduction, 0, 1<<16 );
+    h->param.analyse.i_fast_decision = x264_clip3( h->param.analyse.i_fast_decision, 0, 3 );
     if( h->param.analyse.i_subpel_refine >= 10 && (h->param.analyse.i_trellis != 2 || !h->param.rc.i_aq_mode) )
         h->param.analyse.i_subpel_refine = 9;
 
@@ -1375,8 +1405,10 @@ static int validate_parameters( x264_t *h, int b_open )
     BOOLIFY( b_deblocking_filter );
     BOOLIFY( b_deterministic );
     BOOLIFY( b_sliced_threads );
+    BOOLIFY( b_sliced_threads_balance );
     BOOLIFY( b_interlaced );
     BOOLIFY( b_intra_refresh );
+    BOOLIFY( b_scenecut_prefilter );
     BOOLIFY( b_aud );
     BOOLIFY( b_repeat_headers );
     BOOLIFY( b_annexb );
@@ -1402,6 +1434,7 @@ static int validate_parameters( x264_t *h, int b_open )
     BOOLIFY( rc.b_stat_write );
     BOOLIFY( rc.b_stat_read );
     BOOLIFY( rc.b_mb_tree );
+    BOOLIFY( rc.b_mb_tree_incremental );
     BOOLIFY( rc.b_filler );
 #undef BOOLIFY
 
@@ -1523,10 +1556,16 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
         CHECKED_PARAM_STRDUP( h->param.psz_cqm_file, &h->param, h->param.psz_cqm_file );
     if( h->param.psz_dump_yuv )
         CHECKED_PARAM_STRDUP( h->param.psz_dump_yuv, &h->param, h->param.psz_dump_yuv );
+    if( h->param.psz_cpu_autotune_cache )
+        CHECKED_PARAM_STRDUP( h->param.psz_cpu_autotune_cache, &h->param, h->param.psz_cpu_autotune_cache );
     if( h->param.rc.psz_stat_out )
         CHECKED_PARAM_STRDUP( h->param.rc.psz_stat_out, &h->param, h->param.rc.psz_stat_out );
     if( h->param.rc.psz_stat_in )
         CHECKED_PARAM_STRDUP( h->param.rc.psz_stat_in, &h->param, h->param.rc.psz_stat_in );
+    if( h->param.rc.psz_lookahead_out )
+        CHECKED_PARAM_STRDUP( h->param.rc.psz_lookahead_out, &h->param, h->param.rc.psz_lookahead_out );
+    if( h->param.rc.psz_lookahead_in )
+        CHECKED_PARAM_STRDUP( h->param.rc.psz_lookahead_in, &h->param, h->param.rc.psz_lookahead_in );
     if( h->param.rc.psz_zones )
         CHECKED_PARAM_STRDUP( h->param.rc.psz_zones, &h->param, h->param.rc.psz_zones );
     if( h->param.psz_clbin_file )
@@ -1602,7 +1641,7 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
     h->mb.b_adaptive_mbaff = PARAM_INTERLACED && h->param.analyse.i_subpel_refine;
 
     /* Init frames. */
-    if( h->param.i_bframe_adaptive == X264_B_ADAPT_TRELLIS && !h->param.rc.b_stat_read )
+    if( h->param.i_bframe_adaptive == X264_B_ADAPT_TRELLIS && !h->param.rc.b_stat_read && !h->param.rc.psz_lookahead_in )
         h->frames.i_delay = X264_MAX(h->param.i_bframe,3)*4;
     else
         h->frames.i_delay = h->param.i_bframe;
@@ -1639,6 +1678,9 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
     CHECKED_MALLOCZERO( h->frames.unused[1], (h->i_thread_frames + X264_REF_MAX + 4) * sizeof(x264_frame_t *) );
     CHECKED_MALLOCZERO( h->frames.current, (h->param.i_sync_lookahead + h->param.i_bframe
                         + h->i_thread_frames + 3) * sizeof(x264_frame_t *) );
+    if( h->param.b_sliced_threads_balance )
+        for( int i = 0; i < 3; i++ )
+            CHECKED_MALLOCZERO( h->row_bits_last[i], h->mb.i_mb_height * sizeof(int) );
     if( h->param.analyse.i_weighted_pred > 0 )
         CHECKED_MALLOCZERO( h->frames.blank_unused, h->i_thread_frames * 4 * sizeof(x264_frame_t *) );
     h->i_ref[0] = h->i_ref[1] = 0;
@@ -1667,6 +1709,8 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
     x264_quant_init( h, h->param.cpu, &h->quantf );
     x264_deblock_init( h->param.cpu, &h->loopf, PARAM_INTERLACED );
     x264_bitstream_init( h->param.cpu, &h->bsf );
+    if( (h->param.b_cpu_autotune || h->param.psz_cpu_autotune_cache) && x264_autotune( h ) < 0 )
+        goto fail;
     if( h->param.b_cabac )
         x264_cabac_init( h );
     else
@@ -1763,6 +1807,13 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
         {
             CHECKED_MALLOC( h->lookahead_thread[i], sizeof(x264_t) );
             *h->lookahead_thread[i] = *h;
+            /* MB-tree propagation is split across the lookahead threads too. */
+            if( h->param.rc.b_mb_tree )
+            {
+                if( x264_macroblock_thread_allocate( h->lookahead_thread[i], 1 ) < 0 )
+                    goto fail;
+                CHECKED_MALLOC( h->lookahead_thread[i]->mbtree_propagate_acc, 3 * h->mb.i_mb_count * sizeof(uint16_t) );
+            }
         }
     *h->reconfig_h = *h;
 
@@ -1796,6 +1847,27 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
             goto fail;
     }
 
+    /* Allocate every frame the encode can hold at once, so that encoding only ever recycles
+     * them: the lookahead and frame threads plus the picture being copied in, and the dpb on
+     * top of the recon frame each thread already has. */
+    if( h->param.b_frame_prealloc )
+    {
+        int i_fenc = h->frames.i_delay + 2;
+        int i_fdec = h->frames.i_max_dpb;
+        if( h->param.i_frame_total )
+        {
+            i_fenc = X264_MIN( i_fenc, h->param.i_frame_total );
+            i_fdec = X264_MIN( i_fdec, h->param.i_frame_total );
+        }
+        if( x264_frame_pool_fill( h, 0, i_fenc ) < 0 ||
+            x264_frame_pool_fill( h, 1, i_fdec ) < 0 )
+            goto fail;
+        x264_log( h, X264_LOG_DEBUG, "frame pool: %d input + %d recon frames, %.1f MiB\n",
+                  h->frames.i_allocated[0], h->frames.i_allocated[1], h->frames.i_allocated_size / 1048576. );
+    }
+    h->frames.i_preallocated[0] = h->frames.i_allocated[0];
+    h->frames.i_preallocated[1] = h->frames.i_allocated[1];
+
 #if HAVE_OPENCL
     if( h->param.b_opencl && x264_opencl_lookahead_init( h ) < 0 )
         h->param.b_opencl = 0;
@@ -1811,6 +1883,9 @@ x264_t *x264_encoder_open( x264_param_t *param, void *api )
     if( x264_ratecontrol_new( h ) < 0 )
         goto fail;
 
+    if( x264_speedcontrol_new( h ) < 0 )
+        goto fail;
+
     if( h->param.i_nal_hrd )
     {
         x264_log( h, X264_LOG_DEBUG, "HRD bitrate: %i bits/sec\n", h->sps->vui.hrd.i_bit_rate_unscaled );
@@ -1891,6 +1966,7 @@ static int encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_reconfi
     COPY( analyse.b_chroma_me );
     COPY( analyse.b_dct_decimate );
     COPY( analyse.b_fast_pskip );
+    COPY( analyse.i_fast_decision );
     COPY( analyse.b_mixed_references );
     COPY( analyse.f_psy_rd );
     COPY( analyse.f_psy_trellis );
@@ -1909,6 +1985,7 @@ static int encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_reconfi
     COPY( i_slice_min_mbs );
     COPY( i_slice_count );
     COPY( i_slice_count_max );
+    COPY( i_slice_first_rows );
     COPY( b_tff );
 
     /* VBV can't be turned on if it wasn't on to begin with */
@@ -2051,7 +2128,7 @@ static int check_encapsulated_buffer( x264_t *h, x264_t *h0, int start,
 }
 
 // 封装一帧数据（或者SPS、PPS）对应的NALU（添加起始码、防竞争机制等等），该函数会调用x264_nal_encode()
-static int encoder_encapsulate_nals( x264_t *h, int start )
+static int encoder_encapsulate_nals( x264_t *h, int start, void *opaque )
 {
     x264_t *h0 = h->thread[0];
     int64_t nal_size = 0, previous_nal_size = 0;
@@ -2072,13 +2149,27 @@ static int encoder_encapsulate_nals( x264_t *h, int start )
         nal_size += h->out.nal[i].i_payload;
 
     /* Worst-case NAL unit escaping: reallocate the buffer if it's too small. */
-    int64_t necessary_size = previous_nal_size + nal_size * 3/2 + h->out.i_nal * 4 + 4 + 64;
+    int64_t necessary_size = nal_size * 3/2 + h->out.i_nal * 4 + 4 + 64;
     for( int i = start; i < h->out.i_nal; i++ )
         necessary_size += h->out.nal[i].i_padding;
-    if( check_encapsulated_buffer( h, h0, start, previous_nal_size, necessary_size ) )
-        return -1;
 
-    uint8_t *nal_buffer = h0->nal_buffer + previous_nal_size;
+    uint8_t *nal_buffer;
+    if( h->param.nal_buffer_get )
+    {
+        /* The NALs before start already live in an earlier application buffer. */
+        if( necessary_size > INT_MAX )
+            return -1;
+        nal_buffer = h->param.nal_buffer_get( (x264_t *)h->api, necessary_size, opaque );
+        if( !nal_buffer )
+            return -1;
+    }
+    else
+    {
+        if( check_encapsulated_buffer( h, h0, start, previous_nal_size, previous_nal_size + necessary_size ) )
+            return -1;
+        nal_buffer = h0->nal_buffer + previous_nal_size;
+    }
+    uint8_t *nal_buffer_start = nal_buffer;
 
     // 如果有多个nalu，则一个一个地进行处理
     for( int i = start; i < h->out.i_nal; i++ )
@@ -2091,7 +2182,7 @@ static int encoder_encapsulate_nals( x264_t *h, int start )
 
     x264_emms();
 
-    return nal_buffer - (h0->nal_buffer + previous_nal_size);
+    return nal_buffer - nal_buffer_start;
 }
 
 /****************************************************************************
@@ -2125,7 +2216,7 @@ int x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
     if( nal_end( h ) )
         return -1;
 
-    frame_size = encoder_encapsulate_nals( h, 0 );
+    frame_size = encoder_encapsulate_nals( h, 0, NULL );
     if( frame_size < 0 )
         return -1;
 
@@ -2753,6 +2844,41 @@ static ALWAYS_INLINE void bitstream_restore( x264_t *h, x264_bs_bak_t *bak, int
     }
 }
 
+static void macroblock_export( x264_t *h, int mb_size )
+{
+    /* indexed by i_partition - D_8x8 */
+    static const uint8_t partition_lut[4] = { X264_MBHINT_8x8, X264_MBHINT_16x8, X264_MBHINT_8x16, X264_MBHINT_16x16 };
+    x264_mb_export_t *out = &h->fenc->mb_export[h->mb.i_mb_xy];
+    int i_type = h->mb.i_type;
+
+    if( i_type == I_4x4 )
+        out->i_partition = X264_MBHINT_I4x4;
+    else if( i_type == I_8x8 )
+        out->i_partition = X264_MBHINT_I8x8;
+    else if( IS_INTRA( i_type ) )
+        out->i_partition = X264_MBHINT_I16x16;
+    else if( IS_SKIP( i_type ) )
+        out->i_partition = X264_MBHINT_SKIP;
+    else if( i_type == B_DIRECT )
+        out->i_partition = X264_MBHINT_16x16;
+    else
+        out->i_partition = partition_lut[h->mb.i_partition - D_8x8];
+    out->i_intra_mode = i_type == I_16x16 ? x264_mb_pred_mode16x16_fix[h->mb.i_intra16x16_pred_mode] : -1;
+    out->i_qp = h->mb.qp[h->mb.i_mb_xy];
+    for( int l = 0; l < 2; l++ )
+        for( int i = 0; i < 4; i++ )
+        {
+            int i_ref = !IS_INTRA( i_type ) && (l == 0 || h->sh.i_type == SLICE_TYPE_B) ? h->mb.cache.ref[l][x264_scan8[4*i]] : -1;
+            out->i_ref[l][i] = X264_MAX( i_ref, -1 );
+            if( i_ref >= 0 )
+                CP32( out->mv[l][i], h->mb.cache.mv[l][x264_scan8[4*i]] );
+            else
+                M32( out->mv[l][i] ) = 0;
+        }
+    out->i_satd = h->pixf.satd[PIXEL_16x16]( h->mb.pic.p_fenc[0], FENC_STRIDE, h->mb.pic.p_fdec[0], FDEC_STRIDE );
+    out->i_bits = mb_size;
+}
+
 static intptr_t slice_write( x264_t *h )
 {
     int i_skip;
@@ -2989,6 +3115,9 @@ cont:
         /* accumulate mb stats */
         h->stat.frame.i_mb_count[h->mb.i_type]++;
 
+        if( h->fenc->mb_export )
+            macroblock_export( h, mb_size );
+
         int b_intra = IS_INTRA( h->mb.i_type );
         int b_skip = IS_SKIP( h->mb.i_type );
         if( h->param.i_log_level >= X264_LOG_INFO || h->param.rc.b_stat_write )
@@ -3060,6 +3189,11 @@ cont:
         if( b_deblock )
             x264_macroblock_deblock_strength( h );
 
+        /* slice-first-rows: end the slice on the first row that takes it to the target size. */
+        if( h->i_slice_target_bits && i_mb_x == h->mb.i_mb_width - 1 && (!SLICE_MBAFF || (i_mb_y&1))
+            && total_bits - starting_bits >= h->i_slice_target_bits )
+            h->sh.i_last_mb = X264_MIN( h->sh.i_last_mb, mb_xy );
+
         if( mb_xy == h->sh.i_last_mb )
             break;
 
@@ -3097,6 +3231,9 @@ cont:
     if( nal_end( h ) )
         return -1;
 
+    if( h->param.i_slice_first_rows && !h->sh.i_first_mb )
+        h->stat.frame.i_first_slice_latency = x264_mdate() - h->i_encode_start;
+
     if( h->sh.i_last_mb == (h->i_threadslice_end * h->mb.i_mb_width - 1) )
     {
         h->stat.frame.i_misc_bits = bs_pos( &h->out.bs )
@@ -3128,6 +3265,12 @@ cont:
             h->fdec->mb_info = NULL;
             h->fdec->mb_info_free = NULL;
         }
+        if( h->fdec->mb_hints_free && (!h->param.b_sliced_threads || h->i_thread_idx == (h->param.i_threads-1)) )
+        {
+            h->fdec->mb_hints_free( h->fdec->mb_hints );
+            h->fdec->mb_hints = NULL;
+            h->fdec->mb_hints_free = NULL;
+        }
     }
 
     return 0;
@@ -3169,8 +3312,10 @@ static void *slices_write( x264_t *h )
     /* init stats */
     memset( &h->stat.frame, 0, sizeof(h->stat.frame) );
     h->mb.b_reencode_mb = 0;
+    h->i_slice_target_bits = 0;
     while( h->sh.i_first_mb + SLICE_MBAFF*h->mb.i_mb_stride <= last_thread_mb )
     {
+        int i_slice_start = bs_pos( &h->out.bs );
         h->sh.i_last_mb = last_thread_mb;
         if( !i_slice_num || !x264_frame_new_slice( h, h->fdec ) )
         {
@@ -3194,6 +3339,13 @@ static void *slices_write( x264_t *h )
                 }
                 i_slice_num++;
             }
+            else if( h->param.i_slice_first_rows )
+            {
+                /* slice_write ends the later slices by size. */
+                if( !i_slice_num )
+                    h->sh.i_last_mb = (h->i_threadslice_start + h->param.i_slice_first_rows) * h->mb.i_mb_width - 1;
+                i_slice_num++;
+            }
             else if( h->param.i_slice_count && !h->param.b_sliced_threads )
             {
                 int height = h->mb.i_mb_height >> PARAM_INTERLACED;
@@ -3202,9 +3354,13 @@ static void *slices_write( x264_t *h )
                 h->sh.i_last_mb = (height * i_slice_num + round_bias) / h->param.i_slice_count * width - 1;
             }
         }
+        else
+            h->i_slice_target_bits = 0;
         h->sh.i_last_mb = X264_MIN( h->sh.i_last_mb, last_thread_mb );
         if( slice_write( h ) )
             goto fail;
+        if( h->param.i_slice_first_rows && i_slice_num == 1 )
+            h->i_slice_target_bits = X264_MAX( bs_pos( &h->out.bs ) - i_slice_start, 1 );
         h->sh.i_first_mb = h->sh.i_last_mb + 1;
         // if i_first_mb is not the last mb in a row then go to the next mb in MBAFF order
         if( SLICE_MBAFF && h->sh.i_first_mb % h->mb.i_mb_width )
@@ -3220,9 +3376,63 @@ fail:
     return (void *)-1;
 }
 
+/* Cost of a row (of MB pairs if interlaced) for sliced-threads-balance: the bits it took in the
+ * last frame of this type, plus an even share of the work that doesn't depend on the content. */
+static int64_t threadslice_row_cost( x264_t *h, int y, int64_t base )
+{
+    int *row_bits = h->row_bits_last[h->sh.i_type];
+    int64_t cost = base;
+    for( int i = y << PARAM_INTERLACED; i < (y+1) << PARAM_INTERLACED; i++ )
+        cost += row_bits[i];
+    return cost;
+}
+
+/* Place the thread slice boundaries so that each thread gets the same share of the rows' cost.
+ * Thread i gets rows bounds[i] to bounds[i+1]-1 (in MB pairs if interlaced).
+ * Returns 0 if there is no cost history for this slice type yet. */
+static int threadslices_balance( x264_t *h, int *bounds )
+{
+    int height = h->mb.i_mb_height >> PARAM_INTERLACED;
+    int threads = h->param.i_threads;
+    /* Don't make any thread slice smaller than half its even share. */
+    int min_rows = X264_MAX( height / threads / 2, 1 );
+    int64_t total = 0;
+    for( int y = 0; y < h->mb.i_mb_height; y++ )
+        total += h->row_bits_last[h->sh.i_type][y];
+    if( !total )
+        return 0;
+    /* Half the frame's cost is spread evenly: skipped rows still get analysed and deblocked. */
+    int64_t base = total / height;
+    total += base * height;
+
+    int64_t cost = 0;
+    int y = 0;
+    bounds[0] = 0;
+    for( int i = 0; i < threads; i++ )
+    {
+        int start = y;
+        int max_end = height - min_rows * (threads-1-i);
+        int64_t target = total * (i+1) / threads;
+        for( ; y < start + min_rows; y++ )
+            cost += threadslice_row_cost( h, y, base );
+        while( y < max_end )
+        {
+            int64_t row = threadslice_row_cost( h, y, base );
+            if( i < threads-1 && cost + row/2 > target )
+                break;
+            cost += row;
+            y++;
+        }
+        bounds[i+1] = y;
+    }
+    return 1;
+}
+
 static int threaded_slices_write( x264_t *h )
 {
     int round_bias = h->param.i_avcintra_class ? 0 : h->param.i_slice_count/2;
+    int bounds[X264_THREAD_MAX+1];
+    int b_balanced = h->param.b_sliced_threads_balance && threadslices_balance( h, bounds );
 
     /* set first/last mb and sync contexts */
     for( int i = 0; i < h->param.i_threads; i++ )
@@ -3233,9 +3443,17 @@ static int threaded_slices_write( x264_t *h )
             t->param = h->param;
             memcpy( &t->i_frame, &h->i_frame, offsetof(x264_t, rc) - offsetof(x264_t, i_frame) );
         }
-        int height = h->mb.i_mb_height >> PARAM_INTERLACED;
-        t->i_threadslice_start = ((height *  i    + round_bias) / h->param.i_threads) << PARAM_INTERLACED;
-        t->i_threadslice_end   = ((height * (i+1) + round_bias) / h->param.i_threads) << PARAM_INTERLACED;
+        if( b_balanced )
+        {
+            t->i_threadslice_start = bounds[i]   << PARAM_INTERLACED;
+            t->i_threadslice_end   = bounds[i+1] << PARAM_INTERLACED;
+        }
+        else
+        {
+            int height = h->mb.i_mb_height >> PARAM_INTERLACED;
+            t->i_threadslice_start = ((height *  i    + round_bias) / h->param.i_threads) << PARAM_INTERLACED;
+            t->i_threadslice_end   = ((height * (i+1) + round_bias) / h->param.i_threads) << PARAM_INTERLACED;
+        }
         t->sh.i_first_mb = t->i_threadslice_start * h->mb.i_mb_width;
         t->sh.i_last_mb  =   t->i_threadslice_end * h->mb.i_mb_width - 1;
     }
@@ -3260,6 +3478,9 @@ static int threaded_slices_write( x264_t *h )
 
     x264_threads_merge_ratecontrol( h );
 
+    if( h->param.b_sliced_threads_balance )
+        memcpy( h->row_bits_last[h->sh.i_type], h->fdec->i_row_bits, h->mb.i_mb_height * sizeof(int) );
+
     for( int i = 1; i < h->param.i_threads; i++ )
     {
         x264_t *t = h->thread[i];
@@ -3324,14 +3545,15 @@ int x264_encoder_invalidate_reference( x264_t *h, int64_t pts )
  *       B      5   2*4
  *       B      6   2*5
  ****************************************************************************/
-int     x264_encoder_encode( x264_t *h,
-                             x264_nal_t **pp_nal, int *pi_nal,
-                             x264_picture_t *pic_in,
-                             x264_picture_t *pic_out )
+static int encoder_encode( x264_t *h,
+                           x264_nal_t **pp_nal, int *pi_nal,
+                           x264_picture_t *pic_in,
+                           x264_picture_t *pic_out )
 {
     x264_t *thread_current, *thread_prev, *thread_oldest;
     int i_nal_type, i_nal_ref_idc, i_global_qp;
     int overhead = NALU_OVERHEAD;
+    int64_t i_start = h->param.i_slice_first_rows ? x264_mdate() : 0;
 
 #if HAVE_OPENCL
     if( h->opencl.b_fatal_error )
@@ -3354,6 +3576,7 @@ int     x264_encoder_encode( x264_t *h,
         thread_oldest  = h;
     }
     h->i_cpb_delay_pir_offset = h->i_cpb_delay_pir_offset_next;
+    h->i_encode_start = i_start;
 
     /* no data out */
     *pi_nal = 0;
@@ -3412,7 +3635,12 @@ int     x264_encoder_encode( x264_t *h,
                 fenc->i_pic_struct = PIC_STRUCT_PROGRESSIVE;
         }
 
-        if( h->param.rc.b_mb_tree && h->param.rc.b_stat_read )
+        if( h->param.rc.psz_lookahead_in )
+        {
+            if( x264_lookahead_file_read( h, fenc, pic_in->prop.quant_offsets ) )
+                return -1;
+        }
+        else if( h->param.rc.b_mb_tree && h->param.rc.b_stat_read )
         {
             if( x264_macroblock_tree_read( h, fenc, pic_in->prop.quant_offsets ) )
                 return -1;
@@ -3468,6 +3696,8 @@ int     x264_encoder_encode( x264_t *h,
     {
         x264_encoder_reconfig_apply( h, &h->reconfig_h->param );
         h->reconfig = 0;
+        if( h->sc && x264_speedcontrol_reconfig( h ) < 0 )
+            return -1;
     }
     if( h->fenc->param )
     {
@@ -3478,7 +3708,11 @@ int     x264_encoder_encode( x264_t *h,
             h->fenc->param->param_free( h->fenc->param );
             h->fenc->param = NULL;
         }
+        if( h->sc && x264_speedcontrol_reconfig( h ) < 0 )
+            return -1;
     }
+    if( h->sc && x264_speedcontrol_frame( h ) < 0 )
+        return -1;
     x264_ratecontrol_zone_init( h );
 
     // ok to call this before encoding any frames, since the initial values of fdec have b_kept_as_ref=0
@@ -3565,8 +3799,12 @@ int     x264_encoder_encode( x264_t *h,
 
     h->fdec->mb_info = h->fenc->mb_info;
     h->fdec->mb_info_free = h->fenc->mb_info_free;
+    h->fdec->mb_hints = h->fenc->mb_hints;
+    h->fdec->mb_hints_free = h->fenc->mb_hints_free;
     h->fenc->mb_info = NULL;
     h->fenc->mb_info_free = NULL;
+    h->fenc->mb_hints = NULL;
+    h->fenc->mb_hints_free = NULL;
 
     h->fdec->i_pts = h->fenc->i_pts;
     if( h->frames.i_bframe_delay )
@@ -3905,6 +4143,22 @@ int     x264_encoder_encode( x264_t *h,
     return encoder_frame_end( thread_oldest, thread_current, pp_nal, pi_nal, pic_out );
 }
 
+int     x264_encoder_encode( x264_t *h,
+                             x264_nal_t **pp_nal, int *pi_nal,
+                             x264_picture_t *pic_in,
+                             x264_picture_t *pic_out )
+{
+    if( !h->sc || !pic_in )
+        return encoder_encode( h, pp_nal, pi_nal, pic_in, pic_out );
+
+    /* Charge each input picture with the time spent in here, including waits on the
+     * frame threads, so speed control sees the throughput actually achieved. */
+    int64_t i_start = x264_mdate();
+    int ret = encoder_encode( h, pp_nal, pi_nal, pic_in, pic_out );
+    x264_speedcontrol_update( h, x264_mdate() - i_start );
+    return ret;
+}
+
 static int encoder_frame_end( x264_t *h, x264_t *thread_current,
                               x264_nal_t **pp_nal, int *pi_nal,
                               x264_picture_t *pic_out )
@@ -3944,7 +4198,7 @@ static int encoder_frame_end( x264_t *h, x264_t *thread_current,
         h->out.nal[idx] = nal_tmp;
     }
 
-    int frame_size = encoder_encapsulate_nals( h, 0 );
+    int frame_size = encoder_encapsulate_nals( h, 0, h->fenc->opaque );
     if( frame_size < 0 )
         return -1;
 
@@ -3961,6 +4215,7 @@ static int encoder_frame_end( x264_t *h, x264_t *thread_current,
         x264_log( h, X264_LOG_WARNING, "invalid DTS: PTS is less than DTS\n" );
 
     pic_out->opaque = h->fenc->opaque;
+    pic_out->prop.mb_export = h->fenc->mb_export;
 
     pic_out->img.i_csp = h->fdec->i_csp;
 #if HIGH_BIT_DEPTH
@@ -4030,7 +4285,7 @@ static int encoder_frame_end( x264_t *h, x264_t *thread_current,
             x264_filler_write( h, &h->out.bs, f );
             if( nal_end( h ) )
                 return -1;
-            int total_size = encoder_encapsulate_nals( h, h->out.i_nal-1 );
+            int total_size = encoder_encapsulate_nals( h, h->out.i_nal-1, pic_out->opaque );
             if( total_size < 0 )
                 return -1;
             frame_size += total_size;
@@ -4053,6 +4308,8 @@ static int encoder_frame_end( x264_t *h, x264_t *thread_current,
     h->stat.i_frame_count[h->sh.i_type]++;
     h->stat.i_frame_size[h->sh.i_type] += frame_size;
     h->stat.f_frame_qp[h->sh.i_type] += h->fdec->f_qp_avg_aq;
+    h->stat.i_first_slice_latency[0] += h->stat.frame.i_first_slice_latency;
+    h->stat.i_first_slice_latency[1] = X264_MAX( h->stat.i_first_slice_latency[1], h->stat.frame.i_first_slice_latency );
 
     for( int i = 0; i < X264_MBTYPE_MAX; i++ )
         h->stat.i_mb_count[h->sh.i_type][i] += h->stat.frame.i_mb_count[i];
@@ -4347,6 +4604,15 @@ void    x264_encoder_close  ( x264_t *h )
     }
 
     x264_ratecontrol_summary( h );
+    x264_speedcontrol_summary( h );
+
+    if( h->param.i_slice_first_rows )
+    {
+        int i_count = h->stat.i_frame_count[SLICE_TYPE_I] + h->stat.i_frame_count[SLICE_TYPE_P] + h->stat.i_frame_count[SLICE_TYPE_B];
+        if( i_count )
+            x264_log( h, X264_LOG_INFO, "first slice latency: avg %.2f ms  max %.2f ms\n",
+                      h->stat.i_first_slice_latency[0] / (i_count * 1000.), h->stat.i_first_slice_latency[1] / 1000. );
+    }
 
     if( h->stat.i_frame_count[SLICE_TYPE_I] + h->stat.i_frame_count[SLICE_TYPE_P] + h->stat.i_frame_count[SLICE_TYPE_B] > 0 )
     {
@@ -4514,6 +4780,7 @@ void    x264_encoder_close  ( x264_t *h )
 
     /* rc */
     x264_ratecontrol_delete( h );
+    x264_speedcontrol_delete( h );
 
     /* param */
     x264_param_cleanup( &h->param );
@@ -4521,6 +4788,8 @@ void    x264_encoder_close  ( x264_t *h )
     x264_cqm_delete( h );
     x264_free( h->nal_buffer );
     x264_free( h->reconfig_h );
+    for( int i = 0; i < 3; i++ )
+        x264_free( h->row_bits_last[i] );
     x264_analyse_free_costs( h );
     x264_free( h->cost_table );
 
@@ -4528,6 +4797,10 @@ void    x264_encoder_close  ( x264_t *h )
         h = h->thread[h->i_thread_phase];
 
     /* frames */
+    if( h->param.b_frame_prealloc &&
+        (h->frames.i_allocated[0] > h->frames.i_preallocated[0] || h->frames.i_allocated[1] > h->frames.i_preallocated[1]) )
+        x264_log( h, X264_LOG_DEBUG, "frame pool: %d input + %d recon frames allocated after open\n",
+                  h->frames.i_allocated[0] - h->frames.i_preallocated[0], h->frames.i_allocated[1] - h->frames.i_preallocated[1] );
     x264_frame_delete_list( h->frames.unused[0] );
     x264_frame_delete_list( h->frames.unused[1] );
     x264_frame_delete_list( h->frames.current );
@@ -4543,7 +4816,14 @@ void    x264_encoder_close  ( x264_t *h )
 
     if( h->param.i_lookahead_threads > 1 )
         for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        {
+            if( h->param.rc.b_mb_tree )
+            {
+                x264_macroblock_thread_free( h->lookahead_thread[i], 1 );
+                x264_free( h->lookahead_thread[i]->mbtree_propagate_acc );
+            }
             x264_free( h->lookahead_thread[i] );
+        }
 
     for( int i = h->param.i_threads - 1; i >= 0; i-- )
     {
@@ -4605,3 +4885,108 @@ int x264_encoder_maximum_delayed_frames( x264_t *h )
 {
     return h->frames.i_delay;
 }
+
+/* Return the per-thread frame numbering, timing and reference state to what
+ * x264_encoder_open leaves, so the next frame starts a new IDR sequence. */
+static void encoder_reset_sequence( x264_t *h )
+{
+    h->i_frame = -1;
+    h->i_frame_num = 0;
+    if( h->param.i_avcintra_class )
+        h->i_idr_pic_id = h->param.i_avcintra_class > 200 ? 4 : 5;
+    else
+        h->i_idr_pic_id = 0;
+    h->i_cpb_delay = h->i_coded_fields = h->i_disp_fields = 0;
+    h->i_coded_fields_lookahead = h->i_cpb_delay_lookahead = 0;
+    h->i_cpb_delay_pir_offset = h->i_cpb_delay_pir_offset_next = 0;
+    h->i_prev_duration = ((uint64_t)h->param.i_fps_den * h->sps->vui.i_time_scale) / ((uint64_t)h->param.i_fps_num * h->sps->vui.i_num_units_in_tick);
+    h->i_disp_fields_last_frame = -1;
+    h->b_queued_intra_refresh = 0;
+    h->stat.i_direct_score[0] = h->stat.i_direct_score[1] = 0;
+
+    h->frames.i_last_idr =
+    h->frames.i_last_keyframe = - h->param.i_keyint_max;
+    h->frames.i_input = 0;
+    h->frames.i_largest_pts = h->frames.i_second_largest_pts = -1;
+    h->frames.i_poc_last_open_gop = -1;
+    while( h->frames.reference[0] )
+        x264_frame_push_unused( h, x264_frame_pop( h->frames.reference ) );
+}
+
+int x264_encoder_reset( x264_t *h, x264_param_t *param )
+{
+    if( x264_encoder_delayed_frames( h ) )
+    {
+        x264_log( h, X264_LOG_ERROR, "x264_encoder_reset requires all delayed frames to be flushed first\n" );
+        return -1;
+    }
+    if( h->param.rc.b_stat_read || h->param.rc.b_stat_write )
+    {
+        x264_log( h, X264_LOG_ERROR, "x264_encoder_reset is not supported with multipass encoding\n" );
+        return -1;
+    }
+    /* Lookahead files are indexed by frame number, which starts over, and ratecontrol would
+     * reopen them from the start, so a segment would overwrite the previous one. */
+    if( h->param.rc.psz_lookahead_in || h->param.rc.psz_lookahead_out )
+    {
+        x264_log( h, X264_LOG_ERROR, "x264_encoder_reset is not supported with lookahead files\n" );
+        return -1;
+    }
+
+    x264_t *t = h->thread[h->i_thread_phase];
+    if( param )
+    {
+        x264_param_t param_save = t->param;
+        int rc_reconfig;
+        /* Ratecontrol is rebuilt from scratch, so targets that can't be changed mid-stream can be here. */
+#define COPY(var) t->param.var = param->var
+        COPY( rc.i_bitrate );
+        COPY( rc.i_qp_constant );
+        COPY( rc.f_rate_tolerance );
+        COPY( rc.f_vbv_buffer_init );
+#undef COPY
+        if( encoder_try_reconfig( t, param, &rc_reconfig ) < 0 ||
+            t->mb.b_lossless != ((t->param.rc.i_rc_method == X264_RC_CQP || t->param.rc.i_rc_method == X264_RC_CRF)
+                                 && t->param.rc.i_qp_constant == 0) )
+        {
+            x264_log( h, X264_LOG_ERROR, "x264_encoder_reset: invalid parameters\n" );
+            t->param = param_save;
+            return -1;
+        }
+        x264_sps_init_reconfigurable( t->sps, &t->param );
+        /* The PPS carries the initial QP, so it may change along with the ratecontrol targets.
+         * Keep the 8x8 transform allowed if it was: the param may hold a speed level that has
+         * it turned off, and it couldn't be turned back on afterwards. */
+        int b_transform_8x8_mode = t->pps->b_transform_8x8_mode;
+        x264_pps_init( t->pps, t->param.i_sps_id, &t->param, t->sps );
+        t->pps->b_transform_8x8_mode |= b_transform_8x8_mode;
+        if( t->sc && x264_speedcontrol_reconfig( t ) < 0 )
+            return -1;
+    }
+
+    for( int i = 0; i < h->param.i_threads; i++ )
+    {
+        h->thread[i]->param = t->param;
+        mbcmp_init( h->thread[i] );
+        encoder_reset_sequence( h->thread[i] );
+        h->thread[i]->reconfig = 0;
+    }
+
+    x264_ratecontrol_delete( h );
+    if( x264_ratecontrol_new( h ) < 0 )
+        return -1;
+
+    return x264_lookahead_reset( h );
+}
+
+void x264_encoder_frame_pool_stats( x264_t *h, x264_frame_pool_stats_t *stats )
+{
+    /* The counters travel along with the thread contexts, like the frame lists. */
+    if( h->i_thread_frames > 1 )
+        h = h->thread[h->i_thread_phase];
+    stats->i_input_frames = h->frames.i_allocated[0];
+    stats->i_recon_frames = h->frames.i_allocated[1];
+    stats->i_input_frames_open = h->frames.i_preallocated[0];
+    stats->i_recon_frames_open = h->frames.i_preallocated[1];
+    stats->i_bytes = h->frames.i_allocated_size;
+}
@@ -138,7 +138,7 @@ int x264_lookahead_init( x264_t *h, int i_slicetype_length )
 
     look->i_last_keyframe = - h->param.i_keyint_max;
     look->b_analyse_keyframe = (h->param.rc.b_mb_tree || (h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead))
-                               && !h->param.rc.b_stat_read;
+                               && !h->param.rc.b_stat_read && !h->param.rc.psz_lookahead_in;
     look->i_slicetype_length = i_slicetype_length;
 
     /* init frame lists */
@@ -189,6 +189,40 @@ void x264_lookahead_delete( x264_t *h )
     x264_free( h->lookahead );
 }
 
+/* Start over with an empty lookahead for a new sequence.  Must only be called when no frames
+ * are queued; restarts the lookahead thread if it was shut down by flushing the encoder. */
+int x264_lookahead_reset( x264_t *h )
+{
+    x264_lookahead_t *look = h->lookahead;
+
+    if( h->param.i_sync_lookahead && look->b_exit_thread )
+        x264_pthread_join( look->thread_handle, NULL );
+
+    x264_pthread_mutex_lock( &look->ifbuf.mutex );
+    if( look->last_nonb )
+        x264_frame_push_unused( h, look->last_nonb );
+    look->last_nonb = NULL;
+    look->i_last_keyframe = - h->param.i_keyint_max;
+    look->b_exit_thread = 0;
+    if( h->param.i_sync_lookahead )
+    {
+        x264_t *look_h = h->thread[h->param.i_threads];
+        look_h->param = h->param;
+        look_h->rc = h->rc;
+        look_h->i_coded_fields_lookahead =
+        look_h->i_cpb_delay_lookahead = 0;
+    }
+    x264_pthread_mutex_unlock( &look->ifbuf.mutex );
+
+    if( h->param.i_sync_lookahead && !look->b_thread_active )
+    {
+        if( x264_pthread_create( &look->thread_handle, NULL, (void*)lookahead_thread, h->thread[h->param.i_threads] ) )
+            return -1;
+        look->b_thread_active = 1;
+    }
+    return 0;
+}
+
 void x264_lookahead_put_frame( x264_t *h, x264_frame_t *frame )
 {
     if( h->param.i_sync_lookahead )
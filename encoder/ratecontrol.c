@@ -153,6 +153,20 @@ struct x264_ratecontrol_t
         int srcdim[2];          /* Source dimensions (W/H) */
     } mbtree;
 
+    /* lookahead analysis file */
+    struct
+    {
+        FILE *file_out;
+        char *tmpname;
+        uint8_t *record;        /* Buffer for the record being written */
+        int record_size;
+        FILE *file_in;
+        int header_size;
+        int num_frames;         /* number of records in the input file */
+        uint8_t *frame_type;    /* frame types from the input file, in display order */
+        int b_warned;
+    } lookahead_file;
+
     /* MBRC stuff */
     volatile float frame_size_estimated; /* Access to this variable must be atomic: double is
                                           * not atomic on all arches we care about */
@@ -537,6 +551,17 @@ static void macroblock_tree_rescale( x264_t *h, x264_ratecontrol_t *rc, float *d
     }
 }
 
+static void macroblock_tree_unpack( x264_t *h, x264_ratecontrol_t *rc, x264_frame_t *frame )
+{
+    float *dst = rc->mbtree.rescale_enabled ? rc->mbtree.scale_buffer[0] : frame->f_qp_offset;
+    h->mc.mbtree_fix8_unpack( dst, rc->mbtree.qp_buffer[rc->mbtree.qpbuf_pos], rc->mbtree.src_mb_count );
+    if( rc->mbtree.rescale_enabled )
+        macroblock_tree_rescale( h, rc, frame->f_qp_offset );
+    if( h->frames.b_have_lowres )
+        for( int i = 0; i < h->mb.i_mb_count; i++ )
+            frame->i_inv_qscale_factor[i] = x264_exp2fix8( frame->f_qp_offset[i] );
+}
+
 int x264_macroblock_tree_read( x264_t *h, x264_frame_t *frame, float *quant_offsets )
 {
     x264_ratecontrol_t *rc = h->rc;
@@ -564,13 +589,7 @@ int x264_macroblock_tree_read( x264_t *h, x264_frame_t *frame, float *quant_offs
             } while( i_type != i_type_actual );
         }
 
-        float *dst = rc->mbtree.rescale_enabled ? rc->mbtree.scale_buffer[0] : frame->f_qp_offset;
-        h->mc.mbtree_fix8_unpack( dst, rc->mbtree.qp_buffer[rc->mbtree.qpbuf_pos], rc->mbtree.src_mb_count );
-        if( rc->mbtree.rescale_enabled )
-            macroblock_tree_rescale( h, rc, frame->f_qp_offset );
-        if( h->frames.b_have_lowres )
-            for( int i = 0; i < h->mb.i_mb_count; i++ )
-                frame->i_inv_qscale_factor[i] = x264_exp2fix8( frame->f_qp_offset[i] );
+        macroblock_tree_unpack( h, rc, frame );
         rc->mbtree.qpbuf_pos--;
     }
     else
@@ -628,6 +647,211 @@ static char *strcat_filename( char *input, char *suffix )
     return output;
 }
 
+/* Lookahead analysis file: a fixed-size header followed by one fixed-size record
+ * per frame in display order, so that any frame can be located (or mapped)
+ * without parsing the ones before it. All header fields are big-endian uint32.
+ * Each record is the frame type, three reserved zero bytes and the frame's
+ * quantizer offsets (AQ plus MB-tree) in MB-tree stats format, padded to 16 bytes.
+ * The offsets are only present with LOOKAHEAD_FILE_AQ.  Lowres costs, motion
+ * vectors and propagate costs are not stored, so a reading encode skips the
+ * slicetype analysis and MB-tree, but not the lowres frame costs ratecontrol uses. */
+#define LOOKAHEAD_FILE_MAGIC "x264lkah"
+#define LOOKAHEAD_FILE_VERSION 1
+#define LOOKAHEAD_FILE_HEADER_SIZE 48
+#define LOOKAHEAD_FILE_RECORD_HEADER 4
+#define LOOKAHEAD_FILE_MBTREE 1  /* header flag: records carry MB-tree offsets */
+#define LOOKAHEAD_FILE_AQ     2  /* header flag: records carry quantizer offsets */
+
+enum lookahead_file_field
+{
+    LA_VERSION = 2,
+    LA_HEADER_SIZE,
+    LA_WIDTH,
+    LA_HEIGHT,
+    LA_MB_WIDTH,
+    LA_MB_HEIGHT,
+    LA_FLAGS,
+    LA_RECORD_SIZE,
+    LA_FRAMES,
+};
+
+static int lookahead_file_write_init( x264_t *h, x264_ratecontrol_t *rc )
+{
+    uint32_t header[LOOKAHEAD_FILE_HEADER_SIZE/4] = {0};
+
+    rc->lookahead_file.tmpname = strcat_filename( h->param.rc.psz_lookahead_out, ".temp" );
+    if( !rc->lookahead_file.tmpname )
+        return -1;
+    rc->lookahead_file.file_out = x264_fopen( rc->lookahead_file.tmpname, "wb" );
+    if( !rc->lookahead_file.file_out )
+    {
+        x264_log( h, X264_LOG_ERROR, "ratecontrol_init: can't open lookahead file\n" );
+        return -1;
+    }
+    rc->lookahead_file.record_size = (LOOKAHEAD_FILE_RECORD_HEADER + h->mb.i_mb_count * sizeof(uint16_t) + 15) & ~15;
+    CHECKED_MALLOCZERO( rc->lookahead_file.record, rc->lookahead_file.record_size );
+
+    memcpy( header, LOOKAHEAD_FILE_MAGIC, 8 );
+    header[LA_VERSION]     = endian_fix32( LOOKAHEAD_FILE_VERSION );
+    header[LA_HEADER_SIZE] = endian_fix32( LOOKAHEAD_FILE_HEADER_SIZE );
+    header[LA_WIDTH]       = endian_fix32( h->param.i_width );
+    header[LA_HEIGHT]      = endian_fix32( h->param.i_height );
+    header[LA_MB_WIDTH]    = endian_fix32( h->mb.i_mb_width );
+    header[LA_MB_HEIGHT]   = endian_fix32( h->mb.i_mb_height );
+    header[LA_FLAGS]       = endian_fix32( (h->param.rc.b_mb_tree ? LOOKAHEAD_FILE_MBTREE : 0) |
+                                           (h->param.rc.i_aq_mode ? LOOKAHEAD_FILE_AQ : 0) );
+    header[LA_RECORD_SIZE] = endian_fix32( rc->lookahead_file.record_size );
+    /* The frame count is filled in once the encode is complete. */
+    if( fwrite( header, sizeof(header), 1, rc->lookahead_file.file_out ) < 1 )
+    {
+        x264_log( h, X264_LOG_ERROR, "ratecontrol_init: can't write lookahead file\n" );
+        return -1;
+    }
+    return 0;
+fail:
+    return -1;
+}
+
+static int lookahead_file_write( x264_t *h, x264_ratecontrol_t *rc )
+{
+    FILE *f = rc->lookahead_file.file_out;
+    uint8_t *record = rc->lookahead_file.record;
+
+    record[0] = h->fenc->b_keyframe ? X264_TYPE_KEYFRAME : h->fenc->i_type;
+    if( h->param.rc.i_aq_mode )
+        h->mc.mbtree_fix8_pack( (uint16_t*)(record + LOOKAHEAD_FILE_RECORD_HEADER), h->fenc->f_qp_offset, h->mb.i_mb_count );
+    if( fseek( f, LOOKAHEAD_FILE_HEADER_SIZE + (int64_t)h->fenc->i_frame * rc->lookahead_file.record_size, SEEK_SET ) ||
+        fwrite( record, rc->lookahead_file.record_size, 1, f ) < 1 )
+        return -1;
+    return 0;
+}
+
+static void lookahead_file_write_close( x264_t *h, x264_ratecontrol_t *rc )
+{
+    FILE *f = rc->lookahead_file.file_out;
+    uint32_t frames = endian_fix32( h->i_frame );
+    int b_regular_file = x264_is_regular_file( f );
+    int b_ok = !fseek( f, LA_FRAMES * sizeof(uint32_t), SEEK_SET ) && fwrite( &frames, sizeof(frames), 1, f ) == 1;
+    b_ok &= !fclose( f );
+    if( b_ok && b_regular_file )
+    {
+        if( x264_rename( rc->lookahead_file.tmpname, h->param.rc.psz_lookahead_out ) != 0 )
+            x264_log( h, X264_LOG_ERROR, "failed to rename \"%s\" to \"%s\"\n",
+                      rc->lookahead_file.tmpname, h->param.rc.psz_lookahead_out );
+    }
+    else
+        x264_log( h, X264_LOG_ERROR, "lookahead file \"%s\" is incomplete\n", rc->lookahead_file.tmpname );
+    x264_free( rc->lookahead_file.tmpname );
+    x264_free( rc->lookahead_file.record );
+}
+
+static int lookahead_file_read_init( x264_t *h, x264_ratecontrol_t *rc )
+{
+    uint32_t header[LOOKAHEAD_FILE_HEADER_SIZE/4];
+    FILE *f = rc->lookahead_file.file_in = x264_fopen( h->param.rc.psz_lookahead_in, "rb" );
+    if( !f )
+    {
+        x264_log( h, X264_LOG_ERROR, "ratecontrol_init: can't open lookahead file\n" );
+        return -1;
+    }
+    if( fread( header, sizeof(header), 1, f ) < 1 || memcmp( header, LOOKAHEAD_FILE_MAGIC, 8 ) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file is not valid\n" );
+        return -1;
+    }
+    for( int i = LA_VERSION; i < LOOKAHEAD_FILE_HEADER_SIZE/4; i++ )
+        header[i] = endian_fix32( header[i] );
+    if( header[LA_VERSION] != LOOKAHEAD_FILE_VERSION )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file version %u is not supported\n", header[LA_VERSION] );
+        return -1;
+    }
+    if( h->param.rc.b_mb_tree && !(header[LA_FLAGS] & LOOKAHEAD_FILE_MBTREE) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file was written without mb-tree\n" );
+        return -1;
+    }
+    /* The offsets, which include the writer's AQ, are only read with mb-tree. */
+    if( h->param.rc.b_mb_tree && !(header[LA_FLAGS] & LOOKAHEAD_FILE_AQ) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file was written without adaptive quantization\n" );
+        return -1;
+    }
+    if( !header[LA_WIDTH] || !header[LA_HEIGHT] || header[LA_HEADER_SIZE] < LOOKAHEAD_FILE_HEADER_SIZE ||
+        header[LA_RECORD_SIZE] < LOOKAHEAD_FILE_RECORD_HEADER + header[LA_MB_WIDTH] * header[LA_MB_HEIGHT] * sizeof(uint16_t) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file is not valid\n" );
+        return -1;
+    }
+    rc->lookahead_file.header_size = header[LA_HEADER_SIZE];
+    rc->lookahead_file.record_size = header[LA_RECORD_SIZE];
+    rc->lookahead_file.num_frames = header[LA_FRAMES];
+    if( !rc->lookahead_file.num_frames )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead file is empty\n" );
+        return -1;
+    }
+
+    CHECKED_MALLOC( rc->lookahead_file.frame_type, rc->lookahead_file.num_frames );
+    for( int i = 0; i < rc->lookahead_file.num_frames; i++ )
+    {
+        uint8_t type;
+        if( fseek( f, rc->lookahead_file.header_size + (int64_t)i * rc->lookahead_file.record_size, SEEK_SET ) ||
+            fread( &type, 1, 1, f ) < 1 )
+        {
+            x264_log( h, X264_LOG_ERROR, "Incomplete lookahead file.\n" );
+            return -1;
+        }
+        if( type != X264_TYPE_KEYFRAME && type != X264_TYPE_I && type != X264_TYPE_P &&
+            type != X264_TYPE_BREF && type != X264_TYPE_B )
+        {
+            x264_log( h, X264_LOG_ERROR, "lookahead file has invalid frame type %d at frame %d\n", type, i );
+            return -1;
+        }
+        rc->lookahead_file.frame_type[i] = type;
+    }
+
+    if( h->param.rc.b_mb_tree )
+    {
+        /* Offsets are rescaled like MB-tree stats if the resolution changed. */
+        rc->mbtree.srcdim[0] = header[LA_WIDTH];
+        rc->mbtree.srcdim[1] = header[LA_HEIGHT];
+        if( macroblock_tree_rescale_init( h, rc ) < 0 )
+            return -1;
+        if( rc->mbtree.src_mb_count != header[LA_MB_WIDTH] * header[LA_MB_HEIGHT] )
+        {
+            x264_log( h, X264_LOG_ERROR, "lookahead file was written with different interlacing\n" );
+            return -1;
+        }
+        rc->mbtree.qpbuf_pos = 0;
+    }
+    return 0;
+fail:
+    return -1;
+}
+
+int x264_lookahead_file_read( x264_t *h, x264_frame_t *frame, float *quant_offsets )
+{
+    x264_ratecontrol_t *rc = h->rc;
+
+    x264_adaptive_quant_frame( h, frame, quant_offsets );
+
+    /* Non-reference frames and frames beyond the end of the file only get AQ. */
+    if( !h->param.rc.b_mb_tree || frame->i_frame >= rc->lookahead_file.num_frames ||
+        rc->lookahead_file.frame_type[frame->i_frame] == X264_TYPE_B )
+        return 0;
+
+    int64_t pos = rc->lookahead_file.header_size + (int64_t)frame->i_frame * rc->lookahead_file.record_size;
+    if( fseek( rc->lookahead_file.file_in, pos + LOOKAHEAD_FILE_RECORD_HEADER, SEEK_SET ) ||
+        fread( rc->mbtree.qp_buffer[0], sizeof(uint16_t), rc->mbtree.src_mb_count, rc->lookahead_file.file_in ) != (unsigned)rc->mbtree.src_mb_count )
+    {
+        x264_log( h, X264_LOG_ERROR, "Incomplete lookahead file.\n" );
+        return -1;
+    }
+    macroblock_tree_unpack( h, rc, frame );
+    return 0;
+}
+
 void x264_ratecontrol_init_reconfigurable( x264_t *h, int b_init )
 {
     x264_ratecontrol_t *rc = h->rc;
@@ -777,6 +1001,11 @@ int x264_ratecontrol_new( x264_t *h )
         x264_log( h, X264_LOG_ERROR, "CRF/CQP is incompatible with 2pass.\n" );
         return -1;
     }
+    if( h->param.rc.psz_lookahead_in && (h->param.rc.b_stat_read || h->param.rc.b_stat_write) )
+    {
+        x264_log( h, X264_LOG_ERROR, "lookahead-in is incompatible with multipass.\n" );
+        return -1;
+    }
 
     x264_ratecontrol_init_reconfigurable( h, 1 );
 
@@ -1198,6 +1427,11 @@ parse_error:
             return -1;
     }
 
+    if( h->param.rc.psz_lookahead_in && lookahead_file_read_init( h, rc ) < 0 )
+        return -1;
+    if( h->param.rc.psz_lookahead_out && lookahead_file_write_init( h, rc ) < 0 )
+        return -1;
+
     for( int i = 0; i<h->param.i_threads; i++ )
     {
         h->thread[i]->rc = rc+i;
@@ -1386,6 +1620,11 @@ void x264_ratecontrol_delete( x264_t *h )
     }
     if( rc->p_mbtree_stat_file_in )
         fclose( rc->p_mbtree_stat_file_in );
+    if( rc->lookahead_file.file_out )
+        lookahead_file_write_close( h, rc );
+    if( rc->lookahead_file.file_in )
+        fclose( rc->lookahead_file.file_in );
+    x264_free( rc->lookahead_file.frame_type );
     x264_free( rc->pred );
     x264_free( rc->pred_b_from_p );
     x264_free( rc->entry );
@@ -1451,9 +1690,9 @@ void x264_ratecontrol_start( x264_t *h, int i_force_qp, int overhead )
         }
     }
 
+    memset( h->fdec->i_row_bits, 0, h->mb.i_mb_height * sizeof(int) );
     if( rc->b_vbv )
     {
-        memset( h->fdec->i_row_bits, 0, h->mb.i_mb_height * sizeof(int) );
         memset( h->fdec->f_row_qp, 0, h->mb.i_mb_height * sizeof(float) );
         memset( h->fdec->f_row_qscale, 0, h->mb.i_mb_height * sizeof(float) );
         rc->row_pred = rc->row_preds[h->sh.i_type];
@@ -1801,6 +2040,18 @@ int x264_ratecontrol_slice_type( x264_t *h, int frame_num )
         }
         return rc->entry[frame_num].frame_type;
     }
+    else if( h->param.rc.psz_lookahead_in )
+    {
+        if( frame_num < rc->lookahead_file.num_frames )
+            return rc->lookahead_file.frame_type[frame_num];
+        if( !rc->lookahead_file.b_warned )
+        {
+            x264_log( h, X264_LOG_WARNING, "input has more frames than the lookahead file (%d), "
+                      "using a fixed GOP structure for the rest\n", rc->lookahead_file.num_frames );
+            rc->lookahead_file.b_warned = 1;
+        }
+        return X264_TYPE_AUTO;
+    }
     else
         return X264_TYPE_AUTO;
 }
@@ -1908,6 +2159,12 @@ int x264_ratecontrol_end( x264_t *h, int bits, int *filler )
         }
     }
 
+    if( rc->lookahead_file.file_out && lookahead_file_write( h, rc ) < 0 )
+    {
+        x264_log( h, X264_LOG_ERROR, "ratecontrol_end: lookahead file could not be written to\n" );
+        return -1;
+    }
+
     if( rc->b_abr )
     {
         if( h->sh.i_type != SLICE_TYPE_B )
@@ -53,6 +53,8 @@ int x264_encoder_reconfig_apply( x264_t *h, x264_param_t *param );
 void x264_adaptive_quant_frame( x264_t *h, x264_frame_t *frame, float *quant_offsets );
 #define x264_macroblock_tree_read x264_template(macroblock_tree_read)
 int  x264_macroblock_tree_read( x264_t *h, x264_frame_t *frame, float *quant_offsets );
+#define x264_lookahead_file_read x264_template(lookahead_file_read)
+int  x264_lookahead_file_read( x264_t *h, x264_frame_t *frame, float *quant_offsets );
 #define x264_reference_build_list_optimal x264_template(reference_build_list_optimal)
 int  x264_reference_build_list_optimal( x264_t *h );
 #define x264_thread_sync_ratecontrol x264_template(thread_sync_ratecontrol)
@@ -728,6 +728,8 @@ int quant_trellis_cabac( x264_t *h, dctcoef *dct,
         return h->quantf.trellis_cabac_dc( TRELLIS_ARGS, num_coefs-1 );
 #endif
 
+    /* Targets without the x86-64 trellis asm, including aarch64, run the C dynamic program below. */
+
     // (# of coefs) * (# of ctx) * (# of levels tried) = 1024
     // we don't need to keep all of those: (# of coefs) * (# of ctx) would be enough,
     // but it takes more time to remove dead states than you gain in reduced memory.
@@ -768,7 +770,8 @@ int quant_trellis_cabac( x264_t *h, dctcoef *dct,
         if( !quant_coefs[i] )\
         {\
             /* no need to calculate ssd of 0s: it's the same in all nodes.\
-             * no need to modify level_tree for ctx=0: it starts with an infinite loop of 0s.\
+             * no need to modify level_tree at all: every path codes a 0 here, so the\
+             * output loop fills them in without consuming a level.\
              * subtracting from one score is equivalent to adding to the rest. */\
             if( !ctx_hi )\
             {\
@@ -778,8 +781,6 @@ int quant_trellis_cabac( x264_t *h, dctcoef *dct,
                                    * (uint64_t)lambda2 >> ( CABAC_SIZE_BITS - LAMBDA_BITS );\
                 nodes_cur[0].score -= cost_sig0;\
             }\
-            for( int j = 1; j < (ctx_hi?8:4); j++ )\
-                SET_LEVEL( nodes_cur[j], nodes_cur[j], 0 );\
             continue;\
         }\
 \
@@ -887,6 +888,8 @@ int quant_trellis_cabac( x264_t *h, dctcoef *dct,
     int level = bnode->level_idx;
     for( i = b_ac; i <= last_nnz; i++ )
     {
+        if( !quant_coefs[i] ) // already zero in dct
+            continue;
         dct[zigzag[i]] = SIGN(level_tree[level].abs_level, dct[zigzag[i]]);
         level = level_tree[level].next;
     }
@@ -500,6 +500,143 @@ void x264_weights_analyse( x264_t *h, x264_frame_t *fenc, x264_frame_t *ref, int
     }
 }
 
+/* Hierarchical lookahead ME: an exhaustive search of radius HME_RANGE on the eighth-res
+ * planes, refined with up to HME_REFINE small diamond steps on the quarter-res planes.
+ * Each quarter-res 8x8 block covers 2x2 lowres MBs, whose lowres search it then seeds.
+ * This finds large motion that the lowres search's merange can't reach, at a fraction
+ * of the cost of widening it. */
+#define HME_RANGE 6
+#define HME_REFINE 4
+
+static void slicetype_hme_search( x264_t *h, x264_mb_analysis_t *a, x264_frame_t *fenc, x264_frame_t *fref, int16_t (*mvs)[2] )
+{
+    ALIGNED_ARRAY_16( pixel, pix,[8*FENC_STRIDE] );
+    const uint16_t *p_cost_mv = a->p_cost_mv;
+    int bw0 = (h->mb.i_mb_width+1)>>1;
+    int bh0 = (h->mb.i_mb_height+1)>>1;
+    int bw1 = (h->mb.i_mb_width+3)>>2;
+    int bh1 = (h->mb.i_mb_height+3)>>2;
+    int16_t (*mvs1)[2] = mvs + bw0*bh0;
+
+    /* Eighth-res: mvs in eighth-res fullpel, costed as lowres qpel (x16). */
+    int stride = fenc->i_stride_hme[1];
+    for( int by = 0; by < bh1; by++ )
+        for( int bx = 0; bx < bw1; bx++ )
+        {
+            int x = 8*bx, y = 8*by;
+            pixel *ref = fref->lowres_hme[1] + y*stride + x;
+            int mx_min = X264_MAX( -HME_RANGE, -PADH - x );
+            int mx_max = X264_MIN(  HME_RANGE, fenc->i_width_hme[1] + PADH - 8 - x );
+            int my_min = X264_MAX( -HME_RANGE, -PADV - y );
+            int my_max = X264_MIN(  HME_RANGE, fenc->i_lines_hme[1] + PADV - 8 - y );
+            int bcost = COST_MAX, bmx = 0, bmy = 0;
+            h->mc.copy[PIXEL_8x8]( pix, FENC_STRIDE, fenc->lowres_hme[1] + y*stride + x, stride, 8 );
+            for( int my = my_min; my <= my_max; my++ )
+            {
+                pixel *p = ref + my*stride;
+                int mx = mx_min;
+                for( ; mx + 3 <= mx_max; mx += 4 )
+                {
+                    int costs[4];
+                    h->pixf.sad_x4[PIXEL_8x8]( pix, p+mx, p+mx+1, p+mx+2, p+mx+3, stride, costs );
+                    for( int i = 0; i < 4; i++ )
+                    {
+                        int cost = costs[i] + p_cost_mv[(mx+i)*16] + p_cost_mv[my*16];
+                        if( cost < bcost )
+                        {
+                            bcost = cost;
+                            bmx = mx+i;
+                            bmy = my;
+                        }
+                    }
+                }
+                for( ; mx <= mx_max; mx++ )
+                {
+                    int cost = h->pixf.sad[PIXEL_8x8]( pix, FENC_STRIDE, p+mx, stride ) + p_cost_mv[mx*16] + p_cost_mv[my*16];
+                    if( cost < bcost )
+                    {
+                        bcost = cost;
+                        bmx = mx;
+                        bmy = my;
+                    }
+                }
+            }
+            mvs1[by*bw1+bx][0] = bmx;
+            mvs1[by*bw1+bx][1] = bmy;
+        }
+
+    /* Quarter-res: start from the best of the upscaled parent, zero and the already
+     * refined left and top neighbours, then refine.  Output in lowres qpel (x8). */
+    stride = fenc->i_stride_hme[0];
+    for( int by = 0; by < bh0; by++ )
+        for( int bx = 0; bx < bw0; bx++ )
+        {
+            int x = 8*bx, y = 8*by;
+            pixel *ref = fref->lowres_hme[0] + y*stride + x;
+            /* Neighbour seeds let the vectors keep growing along a row, so besides the
+             * padded plane also stay within the mv cost table, which covers
+             * +-i_mv_range at x8. */
+            int mv_range = h->param.analyse.i_mv_range;
+            int mx_min = X264_MAX( -mv_range, -PADH - x );
+            int mx_max = X264_MIN(  mv_range, fenc->i_width_hme[0] + PADH - 8 - x );
+            int my_min = X264_MAX( -mv_range, -PADV - y );
+            int my_max = X264_MIN(  mv_range, fenc->i_lines_hme[0] + PADV - 8 - y );
+            int16_t (*mv)[2] = &mvs[by*bw0+bx];
+            int16_t cand[4][2] = {{0}};
+            int costs[4];
+            int bcost = COST_MAX, bmx = 0, bmy = 0;
+            h->mc.copy[PIXEL_8x8]( pix, FENC_STRIDE, fenc->lowres_hme[0] + y*stride + x, stride, 8 );
+
+            cand[0][0] = 2*mvs1[(by>>1)*bw1+(bx>>1)][0];
+            cand[0][1] = 2*mvs1[(by>>1)*bw1+(bx>>1)][1];
+            if( bx > 0 )
+            {
+                cand[2][0] = mv[-1][0] >> 3;
+                cand[2][1] = mv[-1][1] >> 3;
+            }
+            if( by > 0 )
+            {
+                cand[3][0] = mv[-bw0][0] >> 3;
+                cand[3][1] = mv[-bw0][1] >> 3;
+            }
+            for( int iter = 0; iter <= HME_REFINE; iter++ )
+            {
+                if( iter )
+                {
+                    int16_t dia[4][2] = {{-1,0},{1,0},{0,-1},{0,1}};
+                    for( int i = 0; i < 4; i++ )
+                    {
+                        cand[i][0] = bmx + dia[i][0];
+                        cand[i][1] = bmy + dia[i][1];
+                    }
+                }
+                for( int i = 0; i < 4; i++ )
+                {
+                    cand[i][0] = x264_clip3( cand[i][0], mx_min, mx_max );
+                    cand[i][1] = x264_clip3( cand[i][1], my_min, my_max );
+                }
+                h->pixf.sad_x4[PIXEL_8x8]( pix, ref + cand[0][0] + cand[0][1]*stride, ref + cand[1][0] + cand[1][1]*stride,
+                                           ref + cand[2][0] + cand[2][1]*stride, ref + cand[3][0] + cand[3][1]*stride,
+                                           stride, costs );
+                int bcost_old = bcost;
+                for( int i = 0; i < 4; i++ )
+                {
+                    int cost = costs[i] + p_cost_mv[cand[i][0]*8] + p_cost_mv[cand[i][1]*8];
+                    if( cost < bcost )
+                    {
+                        bcost = cost;
+                        bmx = cand[i][0];
+                        bmy = cand[i][1];
+                    }
+                }
+                if( iter && bcost == bcost_old )
+                    break;
+            }
+            mv[0][0] = bmx * 8;
+            mv[0][1] = bmy * 8;
+        }
+}
+
 /* Output buffers are separated by 128 bytes to avoid false sharing of cachelines
  * in multithreaded lookahead. */
 #define PAD_SIZE 32
@@ -657,7 +794,7 @@ static void slicetype_mb_cost( x264_t *h, x264_mb_analysis_t *a,
         {
             int i_mvc = 0;
             int16_t (*fenc_mv)[2] = fenc_mvs[l];
-            ALIGNED_ARRAY_8( int16_t, mvc,[4],[2] );
+            ALIGNED_ARRAY_8( int16_t, mvc,[5],[2] );
 
             /* Reverse-order MV prediction. */
             M32( mvc[0] ) = 0;
@@ -678,6 +815,12 @@ static void slicetype_mb_cost( x264_t *h, x264_mb_analysis_t *a,
                 CP32( m[l].mvp, mvc[0] );
             else
                 x264_median_mv( m[l].mvp, mvc[0], mvc[1], mvc[2] );
+            if( h->param.analyse.b_lookahead_hme )
+            {
+                int16_t (*hme_mvs)[2] = l ? fenc->lowres_hme_mvs[1][p1-b-1] : fenc->lowres_hme_mvs[0][b-p0-1];
+                CP32( mvc[i_mvc], hme_mvs[(i_mb_y>>1) * ((h->mb.i_mb_width+1)>>1) + (i_mb_x>>1)] );
+                i_mvc++;
+            }
 
             /* Fast skip for cases of near-zero residual.  Shortcut: don't bother except in the mv0 case,
              * since anything else is likely to have enough residual to not trigger the skip. */
@@ -898,6 +1041,14 @@ static int slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
         else
 #endif
         {
+            if( h->param.analyse.b_lookahead_hme )
+            {
+                if( do_search[0] )
+                    slicetype_hme_search( h, a, fenc, frames[p0], fenc->lowres_hme_mvs[0][b-p0-1] );
+                if( do_search[1] )
+                    slicetype_hme_search( h, a, fenc, frames[p1], fenc->lowres_hme_mvs[1][p1-b-1] );
+            }
+
             if( h->param.i_lookahead_threads > 1 )
             {
                 x264_slicetype_slice_t s[X264_LOOKAHEAD_THREAD_MAX];
@@ -1048,11 +1199,12 @@ static void macroblock_tree_finish( x264_t *h, x264_frame_t *frame, float averag
     }
 }
 
-// 计算当前宏块的遗传代价propagate_cost，同时计算当前宏块集成来自参考块的信息量propagate_amount，并将信息量瓜分到参考块中，最后换算成qp偏移量
-static void macroblock_tree_propagate( x264_t *h, x264_frame_t **frames, float average_duration, int p0, int p1, int b, int referenced )
+/* Propagate rows [start_y,end_y) of frame b into ref_costs.  For non-reffed frames the
+ * caller must have zeroed the first row of b's propagate cost.  With delta, only the
+ * propagate cost in i_propagate_cost_done is passed on, without b's own intra cost. */
+static void macroblock_tree_propagate_rows( x264_t *h, x264_frame_t **frames, float average_duration, int p0, int p1, int b, int referenced,
+                                            int delta, uint16_t *ref_costs[2], int start_y, int end_y )
 {
-    // 取前后向参考帧p0、p1的propagate_cost
-    uint16_t *ref_costs[2] = {frames[p0]->i_propagate_cost,frames[p1]->i_propagate_cost}; 
     // 距离因子，参考帧距离当前帧的距离也决定了信息量的瓜分比例
     int dist_scale_factor = ( ((b-p0) << 8) + ((p1-p0) >> 1) ) / (p1-p0);
     // 预测权重，同理
@@ -1060,27 +1212,31 @@ static void macroblock_tree_propagate( x264_t *h, x264_frame_t **frames, float a
     int16_t (*mvs[2])[2] = { b != p0 ? frames[b]->lowres_mvs[0][b-p0-1] : NULL, b != p1 ? frames[b]->lowres_mvs[1][p1-b-1] : NULL };
     int bipred_weights[2] = {i_bipred_weight, 64 - i_bipred_weight};
     int16_t *buf = h->scratch_buffer;  // 取buffer用于存储计算的propagate_cost
-    uint16_t *propagate_cost = frames[b]->i_propagate_cost;
+    uint16_t *propagate_cost = delta ? frames[b]->i_propagate_cost_done : frames[b]->i_propagate_cost;
     // 取当前帧b以p0为前向参考，p1为后向参考的satd。satd的计算不是在原始像素上进行的，而是在下采样后算的
     uint16_t *lowres_costs = frames[b]->lowres_costs[b-p0][p1-b]; 
 
     x264_emms();
-    float fps_factor = CLIP_DURATION(frames[b]->f_duration) / (CLIP_DURATION(average_duration) * 256.0f) * MBTREE_PRECISION;
+    float fps_factor = delta ? 0 : CLIP_DURATION(frames[b]->f_duration) / (CLIP_DURATION(average_duration) * 256.0f) * MBTREE_PRECISION;
 
-    /* For non-reffed frames the source costs are always zero, so just memset one row and re-use it. */
     // 如果当前帧不被参考，说明它不会遗传信息给其他帧，所以它的遗传代价为0
     // 为什么只用赋值第一行呢？因为其他行也是0，可以直接复用第一行的数据
-    if( !referenced )
-        memset( frames[b]->i_propagate_cost, 0, h->mb.i_mb_width * sizeof(uint16_t) );
+    if( referenced )
+        propagate_cost += start_y * h->mb.i_mb_width;
 
     // 否则，按行来计算每一个宏块的遗传代价propagate_cost（按行来计算）
-    for( h->mb.i_mb_y = 0; h->mb.i_mb_y < h->mb.i_mb_height; h->mb.i_mb_y++ )
+    for( h->mb.i_mb_y = start_y; h->mb.i_mb_y < end_y; h->mb.i_mb_y++ )
     {
         int mb_index = h->mb.i_mb_y*h->mb.i_mb_stride;
         // 1.计算一行数据的propagate_cost，计算值保存到buf中
         h->mc.mbtree_propagate_cost( buf, propagate_cost,
             frames[b]->i_intra_cost+mb_index, lowres_costs+mb_index,
             frames[b]->i_inv_qscale_factor+mb_index, &fps_factor, h->mb.i_mb_width );
+        /* Keep the deltas too small to pass anything on for the next time. */
+        if( delta )
+            for( int x = 0; x < h->mb.i_mb_width; x++ )
+                if( buf[x] )
+                    propagate_cost[x] = 0;
         if( referenced )
             propagate_cost += h->mb.i_mb_width; // 此处就说明了如果不被参考，就复用第一行的数据，不需要转到下一行
 
@@ -1094,17 +1250,245 @@ static void macroblock_tree_propagate( x264_t *h, x264_frame_t **frames, float a
                                          bipred_weights[1], h->mb.i_mb_y, h->mb.i_mb_width, 1 );
         }
     }
+}
+
+// 计算当前宏块的遗传代价propagate_cost，同时计算当前宏块集成来自参考块的信息量propagate_amount，并将信息量瓜分到参考块中，最后换算成qp偏移量
+static void macroblock_tree_propagate( x264_t *h, x264_frame_t **frames, float average_duration, int p0, int p1, int b, int referenced, int delta )
+{
+    // 取前后向参考帧p0、p1的propagate_cost
+    uint16_t *ref_costs[2] = {frames[p0]->i_propagate_cost,frames[p1]->i_propagate_cost}; 
+
+    /* For non-reffed frames the source costs are always zero, so just memset one row and re-use it. */
+    if( !referenced )
+        memset( frames[b]->i_propagate_cost, 0, h->mb.i_mb_width * sizeof(uint16_t) );
+
+    macroblock_tree_propagate_rows( h, frames, average_duration, p0, p1, b, referenced, delta, ref_costs, 0, h->mb.i_mb_height );
 
     // 3.计算每个宏块的量化偏移值
     if( h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead && referenced )
         macroblock_tree_finish( h, frames[b], average_duration, b == p1 ? b - p0 : 0 );
 }
 
+/* With lookahead threads, propagation is split into bands of rows, one per thread.  The
+ * bands' mvs can point anywhere in the reference frames, so each thread accumulates into
+ * private copies of the reference frames' propagate costs, which are summed afterwards.
+ * Every contribution is non-negative, so the saturating sums don't depend on the order
+ * they're done in and the result is identical to the single-threaded one. */
+#define MBTREE_MAX_DST 3 /* size of mbtree_propagate_acc */
+
+typedef struct
+{
+    x264_t *h;
+    x264_frame_t **frames;
+    float average_duration;
+    int (*jobs)[5]; /* p0, p1, b, referenced, delta */
+    int num_jobs;
+    int *dst;
+    int num_dst;
+    uint16_t *acc[MBTREE_MAX_DST];
+    int start_y;
+    int end_y;
+} x264_mbtree_slice_t;
+
+static void macroblock_tree_slice_propagate( x264_mbtree_slice_t *s )
+{
+    x264_t *h = s->h;
+    for( int d = 0; d < s->num_dst; d++ )
+        memset( s->acc[d], 0, h->mb.i_mb_count * sizeof(uint16_t) );
+    for( int j = 0; j < s->num_jobs; j++ )
+    {
+        int p0 = s->jobs[j][0], p1 = s->jobs[j][1];
+        uint16_t *ref_costs[2] = { NULL, NULL };
+        for( int d = 0; d < s->num_dst; d++ )
+        {
+            if( s->dst[d] == p0 )
+                ref_costs[0] = s->acc[d];
+            if( s->dst[d] == p1 )
+                ref_costs[1] = s->acc[d];
+        }
+        macroblock_tree_propagate_rows( h, s->frames, s->average_duration, p0, p1, s->jobs[j][2], s->jobs[j][3], s->jobs[j][4],
+                                        ref_costs, s->start_y, s->end_y );
+    }
+}
+
+static void macroblock_tree_propagate_threaded( x264_t *h, x264_frame_t **frames, float average_duration, int (*jobs)[5], int num_jobs )
+{
+    x264_mbtree_slice_t s[X264_LOOKAHEAD_THREAD_MAX];
+    int dst[MBTREE_MAX_DST];
+    int num_dst = 0;
+    for( int j = 0; j < num_jobs; j++ )
+    {
+        if( !jobs[j][3] )
+            memset( frames[jobs[j][2]]->i_propagate_cost, 0, h->mb.i_mb_width * sizeof(uint16_t) );
+        for( int l = 0; l < 1 + (jobs[j][1] != jobs[j][2]); l++ )
+        {
+            int ref = jobs[j][l];
+            int d = 0;
+            while( d < num_dst && dst[d] != ref )
+                d++;
+            if( d == num_dst )
+                dst[num_dst++] = ref;
+        }
+    }
+    assert( num_dst <= MBTREE_MAX_DST );
+
+    for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+    {
+        x264_t *t = h->lookahead_thread[i];
+        /* The lookahead threads are copied before the mb cache is set up. */
+        t->mb.i_mb_stride = h->mb.i_mb_stride;
+        s[i] = (x264_mbtree_slice_t){ t, frames, average_duration, jobs, num_jobs, dst, num_dst };
+        for( int d = 0; d < num_dst; d++ )
+            s[i].acc[d] = t->mbtree_propagate_acc + d * h->mb.i_mb_count;
+        s[i].start_y = (h->mb.i_mb_height *  i    + h->param.i_lookahead_threads/2) / h->param.i_lookahead_threads;
+        s[i].end_y   = (h->mb.i_mb_height * (i+1) + h->param.i_lookahead_threads/2) / h->param.i_lookahead_threads;
+        x264_threadpool_run( h->lookaheadpool, (void*)macroblock_tree_slice_propagate, &s[i] );
+    }
+    for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        x264_threadpool_wait( h->lookaheadpool, &s[i] );
+
+    for( int d = 0; d < num_dst; d++ )
+    {
+        uint16_t *ref_costs = frames[dst[d]]->i_propagate_cost;
+        for( int i = 0; i < h->param.i_lookahead_threads; i++ )
+        {
+            uint16_t *acc = s[i].acc[d];
+            for( int k = 0; k < h->mb.i_mb_count; k++ )
+                MC_CLIP_ADD( ref_costs[k], acc[k] );
+        }
+    }
+
+    for( int j = 0; j < num_jobs; j++ )
+        if( h->param.rc.i_vbv_buffer_size && h->param.rc.i_lookahead && jobs[j][3] )
+            macroblock_tree_finish( h, frames[jobs[j][2]], average_duration, jobs[j][2] == jobs[j][1] ? jobs[j][2] - jobs[j][0] : 0 );
+}
+
+/* Propagate a set of frames that don't reference each other. */
+static void macroblock_tree_propagate_batch( x264_t *h, x264_frame_t **frames, float average_duration, int (*jobs)[5], int num_jobs )
+{
+    if( !num_jobs )
+        return;
+    if( h->param.i_lookahead_threads == 1 )
+    {
+        for( int j = 0; j < num_jobs; j++ )
+            macroblock_tree_propagate( h, frames, average_duration, jobs[j][0], jobs[j][1], jobs[j][2], jobs[j][3], jobs[j][4] );
+    }
+    else
+        macroblock_tree_propagate_threaded( h, frames, average_duration, jobs, num_jobs );
+
+    if( h->param.rc.b_mb_tree_incremental )
+        for( int j = 0; j < num_jobs; j++ )
+        {
+            x264_frame_t *frame = frames[jobs[j][2]];
+            if( jobs[j][4] )
+                for( int i = 0; i < h->mb.i_mb_count; i++ )
+                    frame->i_propagate_cost_done[i] = frame->i_propagate_cost[i] - frame->i_propagate_cost_done[i];
+            else if( jobs[j][3] )
+                memcpy( frame->i_propagate_cost_done, frame->i_propagate_cost, h->mb.i_mb_count * sizeof(uint16_t) );
+        }
+}
+
+/* Incremental MB-tree: each frame remembers how much of its propagate cost it has already
+ * passed on to its references, so when the lookahead advances, frames analysed by an earlier
+ * call only pass on what the newly arrived frames gave them.  Non-referenced frames have
+ * nothing new to pass on and are skipped.  This is exact up to rounding, as long as the
+ * frame types don't change; if they do, the whole window is redone.  To make that rare, the
+ * last minigop of the window, whose types are still tentative, is left out. */
+static void macroblock_tree_clear( x264_t *h, x264_frame_t *frame, int incremental )
+{
+    if( !incremental || frame->i_mbtree_ref[0] < 0 )
+    {
+        memset( frame->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+        if( h->param.rc.b_mb_tree_incremental )
+            memset( frame->i_propagate_cost_bframes, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+    }
+}
+
+/* A full pass doesn't propagate the b-frames before the first P-frame of the window, but
+ * by then they're already part of its propagate cost here, so keep track of them. */
+static void macroblock_tree_bframes_start( x264_t *h, x264_frame_t *frame, int num_jobs )
+{
+    if( h->param.rc.b_mb_tree_incremental && num_jobs )
+        memcpy( frame->i_propagate_cost_bframes, frame->i_propagate_cost, h->mb.i_mb_count * sizeof(uint16_t) );
+}
+
+static void macroblock_tree_bframes_end( x264_t *h, x264_frame_t *frame, int num_jobs )
+{
+    if( h->param.rc.b_mb_tree_incremental && num_jobs )
+        for( int i = 0; i < h->mb.i_mb_count; i++ )
+            frame->i_propagate_cost_bframes[i] = frame->i_propagate_cost[i] - frame->i_propagate_cost_bframes[i];
+}
+
+static void macroblock_tree_invalidate( x264_t *h, x264_frame_t **frames )
+{
+    frames[0]->i_mbtree_ref[0] = -1;
+    for( int i = 0; i < h->lookahead->next.i_size; i++ )
+        h->lookahead->next.list[i]->i_mbtree_ref[0] = -1;
+}
+
+#define MBTREE_DELTA_MIN 32 /* fraction of the propagate cost a change must reach to be passed on */
+
+/* Returns -1 if frame b was propagated with different references before. */
+static int macroblock_tree_add_job( x264_t *h, x264_frame_t **frames, int (*jobs)[5], int *num_jobs,
+                                    int p0, int p1, int b, int referenced, int incremental )
+{
+    x264_frame_t *fenc = frames[b];
+    int delta = 0;
+    if( incremental && fenc->i_mbtree_ref[0] >= 0 )
+    {
+        if( fenc->i_mbtree_ref[0] != frames[p0]->i_frame || fenc->i_mbtree_ref[1] != frames[p1]->i_frame ||
+            fenc->b_mbtree_referenced != referenced )
+            return -1;
+        if( !referenced )
+            return 0;
+        /* Costs only ever grow, so this can't go negative.  Small changes are left to
+         * accumulate until they're worth passing on. */
+        int64_t cost = 0, change = 0;
+        for( int i = 0; i < h->mb.i_mb_count; i++ )
+        {
+            cost += fenc->i_propagate_cost[i];
+            change += fenc->i_propagate_cost[i] - fenc->i_propagate_cost_done[i];
+        }
+        if( change * MBTREE_DELTA_MIN <= cost )
+            return 0;
+        for( int i = 0; i < h->mb.i_mb_count; i++ )
+            fenc->i_propagate_cost_done[i] = fenc->i_propagate_cost[i] - fenc->i_propagate_cost_done[i];
+        delta = 1;
+    }
+    else if( h->param.rc.b_mb_tree_incremental )
+    {
+        fenc->i_mbtree_ref[0] = frames[p0]->i_frame;
+        fenc->i_mbtree_ref[1] = frames[p1]->i_frame;
+        fenc->b_mbtree_referenced = referenced;
+    }
+    int *job = jobs[(*num_jobs)++];
+    job[0] = p0;
+    job[1] = p1;
+    job[2] = b;
+    job[3] = referenced;
+    job[4] = delta;
+    return 0;
+}
+
 static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **frames, int num_frames, int b_intra )
 {
     int idx = !b_intra;
     int last_nonb, cur_nonb = 1;
     int bframes = 0;
+    int jobs[X264_BFRAME_MAX+1][5];
+    int num_jobs;
+    int incremental = h->param.rc.b_mb_tree_incremental;
+
+#define ADD_JOB( p0, p1, b, referenced )\
+    if( macroblock_tree_add_job( h, frames, jobs, &num_jobs, p0, p1, b, referenced, incremental ) < 0 )\
+    {\
+        /* The frame types changed since the last call: start over. */\
+        macroblock_tree_invalidate( h, frames );\
+        incremental = 0;\
+        i = last_nonb = end_nonb;\
+        macroblock_tree_clear( h, frames[last_nonb], incremental );\
+        goto restart;\
+    }
 
     x264_emms();
     float total_duration = 0.0;
@@ -1120,7 +1504,17 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
     // （向前递推）寻找lookahead队列中最后一个非B帧的位置
     while( i > 0 && IS_X264_TYPE_B( frames[i]->i_type ) )
         i--;
+    /* The types of the last minigop in the window aren't settled yet, so leave it to the next call. */
+    if( incremental && i > idx )
+    {
+        int prev = i - 1;
+        while( prev > idx && IS_X264_TYPE_B( frames[prev]->i_type ) )
+            prev--;
+        if( !IS_X264_TYPE_B( frames[prev]->i_type ) )
+            i = prev;
+    }
     last_nonb = i;
+    int end_nonb = last_nonb;
 
     /* Lookaheadless MB-tree is not a theoretically distinct case; the same extrapolation could
      * be applied to the end of a lookahead buffer of any size.  However, it's most needed when
@@ -1140,7 +1534,7 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
     {
         if( last_nonb < idx )
             return;
-        memset( frames[last_nonb]->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+        macroblock_tree_clear( h, frames[last_nonb], incremental );
     }
 
     //lookahead队列：
@@ -1149,6 +1543,7 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
     //	round2:				                  cur_nonb  ...  last_nonb
     //							          ...
     //	roundn:           cur_nonb	... last_nonb
+restart:
     while( i-- > idx )
     {
         // 寻找当前round的非B帧，即从最后一个非B帧开始向前递推，找到cur_nonb
@@ -1159,16 +1554,17 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
             break;
         // 得到last_nonb以当cur_nonb为前向参考时的所有satd，并记录下来
         slicetype_frame_cost( h, a, frames, cur_nonb, last_nonb, last_nonb );
-        memset( frames[cur_nonb]->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+        macroblock_tree_clear( h, frames[cur_nonb], incremental );
         bframes = last_nonb - cur_nonb - 1;  //这一轮中有多少个B帧（两个nonb帧之间的帧的个数）
         if( h->param.i_bframe_pyramid && bframes > 1 )
         {
             
             int middle = (bframes + 1)/2 + cur_nonb;
             slicetype_frame_cost( h, a, frames, cur_nonb, last_nonb, middle );
-            memset( frames[middle]->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+            macroblock_tree_clear( h, frames[middle], incremental );
             // 循环遍历每一个B帧，根据B帧的位置判断对应的前后向参考帧
             // 此处简化只有中间的B帧可以被参考（最后计算遗传代价），其他B帧均参考非B帧和中间的一个B帧
+            num_jobs = 0;
             while( i > cur_nonb )
             {
                 int p0 = i > middle ? middle : cur_nonb;
@@ -1176,26 +1572,38 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
                 if( i != middle )
                 {
                     slicetype_frame_cost( h, a, frames, p0, p1, i );
-                    macroblock_tree_propagate( h, frames, average_duration, p0, p1, i, 0 );  //其他B帧不被参考，最后一个参数为0
+                    ADD_JOB( p0, p1, i, 0 );  //其他B帧不被参考，最后一个参数为0
                 }
                 i--;
             }
+            int num_bframe_jobs = num_jobs;
+            macroblock_tree_bframes_start( h, frames[last_nonb], num_bframe_jobs );
+            macroblock_tree_propagate_batch( h, frames, average_duration, jobs, num_jobs );
             //中间B帧可以被参考，最后一个参数为1。因为它会被其他B帧参考，参考它的帧会瓜分遗传信息给它（就需要先于它计算），所以它是最后一个计算遗传代价的B帧
-            macroblock_tree_propagate( h, frames, average_duration, cur_nonb, last_nonb, middle, 1 );  
+            num_jobs = 0;
+            ADD_JOB( cur_nonb, last_nonb, middle, 1 );
+            macroblock_tree_propagate_batch( h, frames, average_duration, jobs, num_jobs );
+            macroblock_tree_bframes_end( h, frames[last_nonb], num_bframe_jobs );
         }
         else
         {
             // 不存在B帧作为参考帧，那么所有B帧都以两个nonb帧作为前后向参考帧进行分析
+            num_jobs = 0;
             while( i > cur_nonb )
             {
                 slicetype_frame_cost( h, a, frames, cur_nonb, last_nonb, i );
-                macroblock_tree_propagate( h, frames, average_duration, cur_nonb, last_nonb, i, 0 );  //所有B帧都不被参考，最后一个参数为0
+                ADD_JOB( cur_nonb, last_nonb, i, 0 );  //所有B帧都不被参考，最后一个参数为0
                 i--;
             }
+            macroblock_tree_bframes_start( h, frames[last_nonb], num_jobs );
+            macroblock_tree_propagate_batch( h, frames, average_duration, jobs, num_jobs );
+            macroblock_tree_bframes_end( h, frames[last_nonb], num_jobs );
         }
         // 最后计算last_nonb的遗传代价并瓜分信息到它的参考帧上
         // 为什么最后计算？原理用上面地可以被参考的中间B帧
-        macroblock_tree_propagate( h, frames, average_duration, cur_nonb, last_nonb, last_nonb, 1 );
+        num_jobs = 0;
+        ADD_JOB( cur_nonb, last_nonb, last_nonb, 1 );
+        macroblock_tree_propagate_batch( h, frames, average_duration, jobs, num_jobs );
         // 迭代更新，这一轮的cur_nonb是下一轮的last_nonb。（一轮一轮地，最后计算的就是第一帧）
         last_nonb = cur_nonb;  
     }
@@ -1203,13 +1611,21 @@ static void macroblock_tree( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fr
     if( !h->param.rc.i_lookahead )
     {
         slicetype_frame_cost( h, a, frames, 0, last_nonb, last_nonb );
-        macroblock_tree_propagate( h, frames, average_duration, 0, last_nonb, last_nonb, 1 );
+        macroblock_tree_propagate( h, frames, average_duration, 0, last_nonb, last_nonb, 1, 0 );
         XCHG( uint16_t*, frames[last_nonb]->i_propagate_cost, frames[0]->i_propagate_cost );
     }
 
+    if( h->param.rc.b_mb_tree_incremental )
+    {
+        x264_frame_t *frame = frames[last_nonb];
+        for( int j = 0; j < h->mb.i_mb_count; j++ )
+            frame->i_propagate_cost[j] -= frame->i_propagate_cost_bframes[j];
+        memset( frame->i_propagate_cost_bframes, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+    }
     macroblock_tree_finish( h, frames[last_nonb], average_duration, last_nonb );
     if( h->param.i_bframe_pyramid && bframes > 1 && !h->param.rc.i_vbv_buffer_size )
         macroblock_tree_finish( h, frames[last_nonb+(bframes+1)/2], average_duration, 0 );
+#undef ADD_JOB
 }
 
 static int vbv_frame_cost( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **frames, int p0, int p1, int b )
@@ -1410,6 +1826,30 @@ static void slicetype_path( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **fra
     memcpy( best_paths[length % (X264_BFRAME_MAX+1)], paths[idx^1], length );
 }
 
+/* First stage of scenecut detection: compare the block luma layout of the two frames after
+ * matching their mean and spread, which takes global brightness and contrast changes (fades,
+ * most flashes) out of the picture. The same scene under moderate motion stays well below the
+ * frame's own spread of block luma, while unrelated content lands around or above it.
+ * Returns 0 if the frames are clearly not a scenecut, 1 if the cost-based check is needed. */
+static int scenecut_prefilter( x264_t *h, x264_frame_t *prev, x264_frame_t *cur )
+{
+    int dev0 = prev->i_lowres_luma_dev;
+    int dev1 = cur->i_lowres_luma_dev;
+    /* Nearly flat frames (e.g. the end of a fade to black) don't tell us anything.
+     * The block sums are at the pixel bit depth, so is the threshold. */
+    if( dev0 < (64 << (BIT_DEPTH-8)) || dev1 < (64 << (BIT_DEPTH-8)) )
+        return 1;
+    int64_t scale = ((int64_t)dev1 << 16) / dev0;
+    int64_t diff = 0;
+    for( int i = 0; i < h->mb.i_mb_count; i++ )
+    {
+        int d0 = prev->i_lowres_luma[i] - prev->i_lowres_luma_avg;
+        int d1 = cur->i_lowres_luma[i] - cur->i_lowres_luma_avg;
+        diff += abs( (int)(d0 * scale >> 16) - d1 );
+    }
+    return diff * 2 >= (int64_t)dev1 * h->mb.i_mb_count;
+}
+
 static int scenecut_internal( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **frames, int p0, int p1, int real_scenecut )
 {
     x264_frame_t *frame = frames[p1];
@@ -1418,6 +1858,9 @@ static int scenecut_internal( x264_t *h, x264_mb_analysis_t *a, x264_frame_t **f
     if( real_scenecut && h->param.i_frame_packing == 5 && (frame->i_frame&1) )
         return 0;
 
+    if( h->param.b_scenecut_prefilter && !scenecut_prefilter( h, frames[p0], frame ) )
+        return 0;
+
     slicetype_frame_cost( h, a, frames, p0, p1, p1 );
 
     int icost = frame->i_cost_est[0][0];
@@ -1812,9 +2255,9 @@ void x264_slicetype_decide( x264_t *h )
         }
     }
 
-    if( h->param.rc.b_stat_read )
+    if( h->param.rc.b_stat_read || h->param.rc.psz_lookahead_in )
     {
-        /* Use the frame types from the first pass */
+        /* Use the frame types from the first pass or the lookahead file */
         for( int i = 0; i < h->lookahead->next.i_size; i++ )
             h->lookahead->next.list[i]->i_type =
                 x264_ratecontrol_slice_type( h, h->lookahead->next.list[i]->i_frame );
@@ -1942,7 +2385,8 @@ void x264_slicetype_decide( x264_t *h )
 
         slicetype_frame_cost( h, &a, frames, p0, p1, b );
 
-        if( (p0 != p1 || bframes) && h->param.rc.i_vbv_buffer_size )
+        /* With a lookahead file slicetype_analyse never runs, so the B-frame costs are needed here too. */
+        if( (p0 != p1 || bframes) && (h->param.rc.i_vbv_buffer_size || h->param.rc.psz_lookahead_in) )
         {
             /* We need the intra costs for row SATDs. */
             slicetype_frame_cost( h, &a, frames, b, b, b );
@@ -0,0 +1,260 @@
+/*****************************************************************************
+ * speed.c: realtime speed control
+ *****************************************************************************
+ * Copyright (C) 2003-2022 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "ratecontrol.h"
+#include "speed.h"
+
+/* Buffer fullness below which the analysis is made faster, and above which
+ * a slower level may be tried. */
+#define SPEED_LOW  0.25
+#define SPEED_HIGH 0.75
+/* Longest wait, in multiples of the buffer size, before retrying a level that
+ * couldn't be sustained. */
+#define SPEED_HOLD_MAX 8
+
+typedef struct
+{
+    int subme;
+    int me_method;
+    int me_range;
+    int refs;
+    int inter;
+    int trellis;
+    int b_mixed_refs;
+    int b_8x8dct;
+} speed_level_t;
+
+#define PART_INTRA (X264_ANALYSE_I4x4|X264_ANALYSE_I8x8)
+#define PART_8x8   (PART_INTRA|X264_ANALYSE_PSUB16x16|X264_ANALYSE_BSUB16x16)
+
+/* Roughly follows the presets from ultrafast to slower.  Every setting is capped by
+ * the user's, so the last level, which caps nothing, is the encode as configured.
+ * subme=0 and the exhaustive searches can't be switched back on by reconfig, so the
+ * table never turns them off. */
+static const speed_level_t speed_levels[] =
+{
+    /* subme me            range refs  partitions     trellis mixed 8x8dct */
+    {  1, X264_ME_DIA,       16,  1,  0,                    0, 0, 0 },
+    {  1, X264_ME_DIA,       16,  1,  PART_INTRA,           0, 0, 1 },
+    {  2, X264_ME_HEX,       16,  1,  PART_INTRA,           0, 0, 1 },
+    {  4, X264_ME_HEX,       16,  2,  PART_8x8,             1, 0, 1 },
+    {  6, X264_ME_HEX,       16,  2,  PART_8x8,             1, 1, 1 },
+    {  7, X264_ME_HEX,       16,  3,  PART_8x8,             1, 1, 1 },
+    {  8, X264_ME_UMH,       16,  5,  PART_8x8,             1, 1, 1 },
+    {  9, X264_ME_UMH,       16,  8,  PART_8x8|X264_ANALYSE_PSUB8x8, 2, 1, 1 },
+    { 11, X264_ME_TESA,    1024, 16, ~0,                    2, 1, 1 },
+};
+#define SPEED_LEVELS ARRAY_ELEMS(speed_levels)
+
+struct x264_speedcontrol_t
+{
+    double budget;          /* target encoding time per frame, in us */
+    double buffer;          /* encoding time saved up by previous frames, in us */
+    double buffer_size;
+    double last;            /* encoding time of the last frame, in us */
+    int    level;
+    int    frames_at_level;
+    int    hold;            /* frames to wait at a level before trying a slower one */
+    int    b_probe;         /* the level was just raised and hasn't proven sustainable yet */
+    speed_level_t user;     /* the slowest settings allowed */
+    speed_level_t applied;  /* the settings in use, after validation */
+    int    user_intra;
+    int    applied_intra;
+    int    i_changes;
+    int    i_late;          /* frames that ran over an empty buffer */
+    int64_t level_frames[SPEED_LEVELS];
+};
+
+static void speed_level_read( speed_level_t *l, x264_param_t *param )
+{
+    l->subme        = param->analyse.i_subpel_refine;
+    l->me_method    = param->analyse.i_me_method;
+    l->me_range     = param->analyse.i_me_range;
+    l->refs         = param->i_frame_reference;
+    l->inter        = param->analyse.inter;
+    l->trellis      = param->analyse.i_trellis;
+    l->b_mixed_refs = param->analyse.b_mixed_references;
+    l->b_8x8dct     = param->analyse.b_transform_8x8;
+}
+
+int x264_speedcontrol_new( x264_t *h )
+{
+    x264_speedcontrol_t *sc;
+    double fps = 25.0;
+
+    if( h->param.sc.f_speed <= 0 )
+        return 0;
+
+    CHECKED_MALLOCZERO( sc, sizeof(x264_speedcontrol_t) );
+    if( h->param.i_fps_num > 0 && h->param.i_fps_den > 0 )
+        fps = (double)h->param.i_fps_num / h->param.i_fps_den;
+    sc->budget = 1e6 / (fps * h->param.sc.f_speed);
+    sc->buffer_size = sc->budget * h->param.sc.i_buffer_size;
+    sc->buffer = sc->buffer_size * SPEED_HIGH;
+    sc->level = SPEED_LEVELS - 1;
+    sc->hold = h->param.sc.i_buffer_size;
+
+    speed_level_read( &sc->user, &h->param );
+    sc->applied = sc->user;
+    sc->user_intra = sc->applied_intra = h->param.analyse.intra;
+
+    for( int i = 0; i < h->param.i_threads; i++ )
+        h->thread[i]->sc = sc;
+    return 0;
+fail:
+    return -1;
+}
+
+void x264_speedcontrol_delete( x264_t *h )
+{
+    x264_free( h->sc );
+}
+
+static void speed_level_apply( x264_speedcontrol_t *sc, x264_param_t *param, int level )
+{
+    const speed_level_t *l = &speed_levels[level];
+    param->analyse.i_subpel_refine    = X264_MIN( l->subme, sc->user.subme );
+    param->analyse.i_me_method        = X264_MIN( l->me_method, sc->user.me_method );
+    param->analyse.i_me_range         = X264_MIN( l->me_range, sc->user.me_range );
+    param->i_frame_reference          = X264_MIN( l->refs, sc->user.refs );
+    param->analyse.inter              = l->inter & sc->user.inter;
+    param->analyse.i_trellis          = X264_MIN( l->trellis, sc->user.trellis );
+    param->analyse.b_mixed_references = l->b_mixed_refs && sc->user.b_mixed_refs;
+    param->analyse.b_transform_8x8    = l->b_8x8dct && sc->user.b_8x8dct;
+    /* validate_parameters drops i8x8 along with the 8x8 transform, so restore it too. */
+    param->analyse.intra              = sc->user_intra;
+}
+
+/* Switch h->param to the given level and remember what validation left of it. */
+static int speed_level_set( x264_t *h, int level )
+{
+    x264_speedcontrol_t *sc = h->sc;
+    x264_param_t param = h->param;
+    speed_level_apply( sc, &param, level );
+    if( x264_encoder_reconfig_apply( h, &param ) < 0 )
+        return -1;
+    speed_level_read( &sc->applied, &h->param );
+    sc->applied_intra = h->param.analyse.intra;
+    return 0;
+}
+
+/* Called after a user reconfig.  The new params were built from h->param, which holds the
+ * current level's settings, so only the fields that differ from those were changed by the
+ * user: they replace the corresponding ceilings, and the current level is applied again on
+ * top.  If none of the settings we control changed (e.g. only the crf did), there is nothing
+ * to do. */
+int x264_speedcontrol_reconfig( x264_t *h )
+{
+    x264_speedcontrol_t *sc = h->sc;
+    speed_level_t cur;
+    speed_level_read( &cur, &h->param );
+    if( !memcmp( &cur, &sc->applied, sizeof(speed_level_t) ) && h->param.analyse.intra == sc->applied_intra )
+        return 0;
+
+#define UPDATE(var) if( cur.var != sc->applied.var ) sc->user.var = cur.var
+    UPDATE( subme );
+    UPDATE( me_method );
+    UPDATE( me_range );
+    UPDATE( refs );
+    UPDATE( inter );
+    UPDATE( trellis );
+    UPDATE( b_mixed_refs );
+    UPDATE( b_8x8dct );
+#undef UPDATE
+    if( h->param.analyse.intra != sc->applied_intra )
+        sc->user_intra = h->param.analyse.intra;
+
+    return speed_level_set( h, sc->level );
+}
+
+/* Called before encoding each frame: pick the analysis level from the state of the buffer. */
+int x264_speedcontrol_frame( x264_t *h )
+{
+    x264_speedcontrol_t *sc = h->sc;
+    double fill = sc->buffer / sc->buffer_size;
+    int level = sc->level;
+
+    sc->frames_at_level++;
+    if( sc->b_probe && sc->frames_at_level >= sc->hold && fill >= SPEED_LOW )
+    {
+        sc->b_probe = 0;
+        sc->hold = h->param.sc.i_buffer_size;
+    }
+
+    /* A level change takes effect after the frames already in flight, and the buffer takes a
+     * while to refill after it does, so only go faster while frames are still over budget. */
+    if( fill < SPEED_LOW && sc->last > sc->budget && level > 0 && sc->frames_at_level >= h->i_thread_frames )
+    {
+        /* Backing out of a level we only just tried means it's too slow for the current
+         * content, so wait longer before trying it again. */
+        if( sc->b_probe )
+            sc->hold = X264_MIN( sc->hold * 2, SPEED_HOLD_MAX * h->param.sc.i_buffer_size );
+        sc->b_probe = 0;
+        level--;
+    }
+    else if( fill > SPEED_HIGH && level < SPEED_LEVELS - 1 && sc->frames_at_level >= sc->hold )
+    {
+        sc->b_probe = 1;
+        level++;
+    }
+
+    sc->level_frames[level]++;
+    if( level == sc->level )
+        return 0;
+
+    x264_log( h, X264_LOG_DEBUG, "speed: level %d -> %d, buffer %.1f%%\n", sc->level, level, fill * 100 );
+    sc->level = level;
+    sc->frames_at_level = 0;
+    sc->i_changes++;
+
+    return speed_level_set( h, level );
+}
+
+/* Called after each x264_encoder_encode that was given a picture, with the time it took. */
+void x264_speedcontrol_update( x264_t *h, int64_t i_elapsed )
+{
+    x264_speedcontrol_t *sc = h->sc;
+    double buffer = sc->buffer + sc->budget - i_elapsed;
+    sc->last = i_elapsed;
+    sc->i_late += buffer < 0;
+    sc->buffer = x264_clip3f( buffer, 0, sc->buffer_size );
+}
+
+void x264_speedcontrol_summary( x264_t *h )
+{
+    x264_speedcontrol_t *sc = h->sc;
+    int64_t i_frames = 0;
+    char buf[16*SPEED_LEVELS];
+    char *p = buf;
+
+    if( !sc )
+        return;
+    for( int i = 0; i < SPEED_LEVELS; i++ )
+        i_frames += sc->level_frames[i];
+    if( !i_frames )
+        return;
+    for( int i = 0; i < SPEED_LEVELS; i++ )
+        p += sprintf( p, " %4.1f%%", sc->level_frames[i] * 100. / i_frames );
+    x264_log( h, X264_LOG_INFO, "speed levels:%s  changes: %d  late: %d\n", buf, sc->i_changes, sc->i_late );
+}
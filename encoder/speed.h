@@ -0,0 +1,40 @@
+/*****************************************************************************
+ * speed.h: realtime speed control
+ *****************************************************************************
+ * Copyright (C) 2003-2022 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#ifndef X264_ENCODER_SPEED_H
+#define X264_ENCODER_SPEED_H
+
+#define x264_speedcontrol_new x264_template(speedcontrol_new)
+int  x264_speedcontrol_new( x264_t *h );
+#define x264_speedcontrol_delete x264_template(speedcontrol_delete)
+void x264_speedcontrol_delete( x264_t *h );
+#define x264_speedcontrol_reconfig x264_template(speedcontrol_reconfig)
+int  x264_speedcontrol_reconfig( x264_t *h );
+#define x264_speedcontrol_frame x264_template(speedcontrol_frame)
+int  x264_speedcontrol_frame( x264_t *h );
+#define x264_speedcontrol_update x264_template(speedcontrol_update)
+void x264_speedcontrol_update( x264_t *h, int64_t i_elapsed );
+#define x264_speedcontrol_summary x264_template(speedcontrol_summary)
+void x264_speedcontrol_summary( x264_t *h );
+
+#endif
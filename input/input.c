@@ -147,6 +147,22 @@ const x264_cli_csp_t *x264_cli_get_csp( int csp )
 }
 
 /* Functions for handling memory-mapped input frames */
+/* Third-party filters such as swscale can overread the input buffer which may result
+ * in segfaults. We have to pad the buffer size as a workaround to avoid that. */
+#define MMAP_PADDING 64
+
+#if !defined(_WIN32) && HAVE_MMAP
+/* Remap the file mapping of any padding that crosses a page boundary past the end of
+ * the file into a copy of the last valid page to prevent reads from invalid memory. */
+static void mmap_pad_tail( cli_mmap_t *h, uint8_t *base, int64_t offset, int64_t size )
+{
+    size_t padded_size = size + MMAP_PADDING;
+    size_t aligned_size = (padded_size - 1) & ~h->align_mask;
+    if( offset + aligned_size >= h->file_size )
+        mmap( base + aligned_size, padded_size - aligned_size, PROT_READ, MAP_PRIVATE|MAP_FIXED, h->fd, (offset + size - 1) & ~h->align_mask );
+}
+#endif
+
 int x264_cli_mmap_init( cli_mmap_t *h, FILE *fh )
 {
 #if defined(_WIN32) || HAVE_MMAP
@@ -171,17 +187,28 @@ int x264_cli_mmap_init( cli_mmap_t *h, FILE *fh )
 #elif HAVE_MMAP && defined(_SC_PAGESIZE)
         h->align_mask = sysconf( _SC_PAGESIZE ) - 1;
         h->fd = fd;
-        return h->align_mask < 0 || fd < 0;
+        h->base = NULL;
+        if( h->align_mask < 0 || fd < 0 )
+            return -1;
+        /* Map the whole file once if the address space allows it, so that reading a frame
+         * doesn't cost an mmap/munmap pair and its page table teardown. Frames are mapped
+         * individually otherwise. */
+        if( sizeof(size_t) > 4 && h->file_size > 0 && (uint64_t)h->file_size <= SIZE_MAX - MMAP_PADDING )
+        {
+            uint8_t *base = mmap( NULL, h->file_size + MMAP_PADDING, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( base != MAP_FAILED )
+            {
+                mmap_pad_tail( h, base, 0, h->file_size );
+                h->base = base;
+            }
+        }
+        return 0;
 #endif
     }
 #endif
     return -1;
 }
 
-/* Third-party filters such as swscale can overread the input buffer which may result
- * in segfaults. We have to pad the buffer size as a workaround to avoid that. */
-#define MMAP_PADDING 64
-
 void *x264_cli_mmap( cli_mmap_t *h, int64_t offset, int64_t size )
 {
 #if defined(_WIN32) || HAVE_MMAP
@@ -226,6 +253,24 @@ void *x264_cli_mmap( cli_mmap_t *h, int64_t offset, int64_t size )
         return base + align;
     }
 #else
+    if( h->base )
+    {
+        if( (uint64_t)offset + size > (uint64_t)h->file_size )
+            return NULL;
+        base = h->base + offset;
+        /* Populating the page tables for the whole frame up front avoids taking
+         * a page fault for every few pages once the frame is read. */
+#ifdef MADV_POPULATE_READ
+        if( !madvise( base, size, MADV_POPULATE_READ ) )
+            return base + align;
+#endif
+#ifdef MADV_WILLNEED
+        madvise( base, size, MADV_WILLNEED );
+#elif defined(POSIX_MADV_WILLNEED)
+        posix_madvise( base, size, POSIX_MADV_WILLNEED );
+#endif
+        return base + align;
+    }
     size_t padded_size = size + MMAP_PADDING;
     if( (base = mmap( NULL, padded_size, PROT_READ, MAP_PRIVATE, h->fd, offset )) != MAP_FAILED )
     {
@@ -238,12 +283,7 @@ void *x264_cli_mmap( cli_mmap_t *h, int64_t offset, int64_t size )
 #elif defined(POSIX_MADV_WILLNEED)
         posix_madvise( base, size, POSIX_MADV_WILLNEED );
 #endif
-        /* Remap the file mapping of any padding that crosses a page boundary past the end of
-         * the file into a copy of the last valid page to prevent reads from invalid memory. */
-        size_t aligned_size = (padded_size - 1) & ~h->align_mask;
-        if( offset + aligned_size >= h->file_size )
-            mmap( base + aligned_size, padded_size - aligned_size, PROT_READ, MAP_PRIVATE|MAP_FIXED, h->fd, (offset + size - 1) & ~h->align_mask );
-
+        mmap_pad_tail( h, base, offset, size );
         return base + align;
     }
 #endif
@@ -260,6 +300,15 @@ int x264_cli_munmap( cli_mmap_t *h, void *addr, int64_t size )
 #else
     if( size < 0 || size > (SIZE_MAX - MMAP_PADDING - ((intptr_t)addr - (intptr_t)base)) )
         return -1;
+    if( h->base )
+    {
+        /* Drop the frame's pages from the process so memory use stays bounded like with
+         * per-frame mappings; the page cache keeps them for a cheap refault if needed. */
+#ifdef MADV_DONTNEED
+        madvise( base, size + (intptr_t)addr - (intptr_t)base, MADV_DONTNEED );
+#endif
+        return 0;
+    }
     return munmap( base, size + MMAP_PADDING + (intptr_t)addr - (intptr_t)base );
 #endif
 #endif
@@ -270,5 +319,8 @@ void x264_cli_mmap_close( cli_mmap_t *h )
 {
 #ifdef _WIN32
     CloseHandle( h->map_handle );
+#elif HAVE_MMAP
+    if( h->base )
+        munmap( h->base, h->file_size + MMAP_PADDING );
 #endif
 }
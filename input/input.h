@@ -147,6 +147,7 @@ typedef struct
     HANDLE map_handle;
 #elif HAVE_MMAP
     int fd;
+    uint8_t *base; /* whole-file mapping, NULL if frames are mapped individually */
 #endif
 } cli_mmap_t;
 
@@ -0,0 +1,235 @@
+/*****************************************************************************
+ * segbench.c: segment startup latency, x264_encoder_open vs x264_encoder_reset
+ *****************************************************************************
+ * Copyright (C) 2026 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common/osdep.h"
+#include <x264.h>
+
+#define RUNS 3
+
+typedef struct
+{
+    x264_param_t param;
+    x264_picture_t pic;
+    int i_segment_frames;
+    int i_segments;
+    uint32_t hash;
+} bench_t;
+
+static void put_pixel( bench_t *b, int p, int x, int y, int v )
+{
+    uint8_t *dst = b->pic.img.plane[p] + y * b->pic.img.i_stride[p];
+    v &= 255;
+    if( b->pic.img.i_csp & X264_CSP_HIGH_DEPTH )
+        ((uint16_t*)dst)[x] = v << (b->param.i_bitdepth - 8);
+    else
+        dst[x] = v;
+}
+
+/* Synthetic input: a gradient panning one pixel per frame with some texture,
+ * so that motion search and ratecontrol do representative work. */
+static void fill_frame( bench_t *b, int i_frame )
+{
+    int width = b->param.i_width;
+    int height = b->param.i_height;
+    for( int y = 0; y < height; y++ )
+        for( int x = 0; x < width; x++ )
+            put_pixel( b, 0, x, y, (x + y + i_frame) * 3 + ((x*y) >> 4 & 15) );
+    for( int p = 1; p < 3; p++ )
+        for( int y = 0; y < height/2; y++ )
+            for( int x = 0; x < width/2; x++ )
+                put_pixel( b, p, x, y, 128 + ((x + i_frame) >> 2) - (y >> 2) * p );
+}
+
+static void hash_nals( bench_t *b, x264_nal_t *nal, int i_nal )
+{
+    for( int i = 0; i < i_nal; i++ )
+        if( nal[i].i_type != NAL_SEI )
+            for( int j = 0; j < nal[i].i_payload; j++ )
+                b->hash = (b->hash ^ nal[i].p_payload[j]) * 16777619;
+}
+
+/* Encode one segment starting at input frame i_start and flush it. */
+static int encode_segment( bench_t *b, x264_t *h, int i_start )
+{
+    x264_picture_t pic_out;
+    x264_nal_t *nal;
+    int i_nal;
+
+    for( int i = 0; i < b->i_segment_frames; i++ )
+    {
+        fill_frame( b, i_start + i );
+        b->pic.i_pts = i;
+        if( x264_encoder_encode( h, &nal, &i_nal, &b->pic, &pic_out ) < 0 )
+            return -1;
+        hash_nals( b, nal, i_nal );
+    }
+    while( x264_encoder_delayed_frames( h ) )
+    {
+        if( x264_encoder_encode( h, &nal, &i_nal, NULL, &pic_out ) < 0 )
+            return -1;
+        hash_nals( b, nal, i_nal );
+    }
+    return 0;
+}
+
+static int64_t bench_open_close( bench_t *b )
+{
+    int64_t t = x264_mdate();
+    for( int i = 0; i < b->i_segments; i++ )
+    {
+        x264_t *h = x264_encoder_open( &b->param );
+        if( !h )
+            return -1;
+        x264_encoder_close( h );
+    }
+    return x264_mdate() - t;
+}
+
+static int64_t bench_reset( bench_t *b )
+{
+    x264_t *h = x264_encoder_open( &b->param );
+    if( !h )
+        return -1;
+    int64_t t = x264_mdate();
+    for( int i = 0; i < b->i_segments; i++ )
+        if( x264_encoder_reset( h, NULL ) < 0 )
+        {
+            x264_encoder_close( h );
+            return -1;
+        }
+    t = x264_mdate() - t;
+    x264_encoder_close( h );
+    return t;
+}
+
+static int64_t bench_segments_reopen( bench_t *b )
+{
+    b->hash = 2166136261U;
+    int64_t t = x264_mdate();
+    for( int i = 0; i < b->i_segments; i++ )
+    {
+        x264_t *h = x264_encoder_open( &b->param );
+        if( !h )
+            return -1;
+        int ret = encode_segment( b, h, i * b->i_segment_frames );
+        x264_encoder_close( h );
+        if( ret < 0 )
+            return -1;
+    }
+    return x264_mdate() - t;
+}
+
+static int64_t bench_segments_reset( bench_t *b )
+{
+    b->hash = 2166136261U;
+    int64_t t = x264_mdate();
+    x264_t *h = x264_encoder_open( &b->param );
+    if( !h )
+        return -1;
+    for( int i = 0; i < b->i_segments; i++ )
+        if( (i && x264_encoder_reset( h, NULL ) < 0) ||
+            encode_segment( b, h, i * b->i_segment_frames ) < 0 )
+        {
+            x264_encoder_close( h );
+            return -1;
+        }
+    x264_encoder_close( h );
+    return x264_mdate() - t;
+}
+
+/* Best of RUNS, in microseconds per segment. */
+static double run( bench_t *b, int64_t (*func)( bench_t * ) )
+{
+    int64_t best = INT64_MAX;
+    for( int i = 0; i < RUNS; i++ )
+    {
+        int64_t t = func( b );
+        if( t < 0 )
+        {
+            fprintf( stderr, "segbench: encoder failure\n" );
+            exit( 1 );
+        }
+        if( t < best )
+            best = t;
+    }
+    return (double)best / b->i_segments;
+}
+
+int main( int argc, char **argv )
+{
+    bench_t b;
+    const char *preset = argc > 1 ? argv[1] : "medium";
+    int width = 352, height = 288;
+
+    b.i_segment_frames = argc > 2 ? atoi( argv[2] ) : 2;
+    b.i_segments = argc > 3 ? atoi( argv[3] ) : 20;
+    if( argc > 4 && sscanf( argv[4], "%dx%d", &width, &height ) != 2 )
+        b.i_segments = 0;
+    if( argc > 5 || b.i_segment_frames < 1 || b.i_segments < 1 || width < 16 || height < 16 )
+    {
+        fprintf( stderr, "usage: segbench [preset [frames-per-segment [segments [WxH]]]]\n" );
+        return 1;
+    }
+
+    if( x264_param_default_preset( &b.param, preset, NULL ) < 0 )
+    {
+        fprintf( stderr, "segbench: unknown preset \"%s\"\n", preset );
+        return 1;
+    }
+    b.param.i_width = width & ~1;
+    b.param.i_height = height & ~1;
+    b.param.i_fps_num = 25;
+    b.param.i_fps_den = 1;
+    b.param.i_log_level = X264_LOG_ERROR;
+#if X264_BIT_DEPTH > 8
+    b.param.i_bitdepth = X264_BIT_DEPTH;
+    b.param.i_csp = X264_CSP_I420 | X264_CSP_HIGH_DEPTH;
+#endif
+    if( x264_picture_alloc( &b.pic, b.param.i_csp, b.param.i_width, b.param.i_height ) < 0 )
+        return 1;
+
+    double open_close = run( &b, bench_open_close );
+    double reset = run( &b, bench_reset );
+    double seg_reopen = run( &b, bench_segments_reopen );
+    uint32_t hash_reopen = b.hash;
+    double seg_reset = run( &b, bench_segments_reset );
+
+    printf( "%s %dx%d, %d segments of %d frames, best of %d runs, per segment:\n",
+            preset, b.param.i_width, b.param.i_height, b.i_segments, b.i_segment_frames, RUNS );
+    printf( "  x264_encoder_open + close  %10.3f ms\n", open_close / 1000 );
+    printf( "  x264_encoder_reset         %10.3f ms\n", reset / 1000 );
+    printf( "  segment, reopen            %10.3f ms\n", seg_reopen / 1000 );
+    printf( "  segment, reset             %10.3f ms\n", seg_reset / 1000 );
+
+    x264_picture_clean( &b.pic );
+    if( hash_reopen != b.hash )
+    {
+        fprintf( stderr, "segbench: output after x264_encoder_reset differs from a reopened encoder\n" );
+        return 1;
+    }
+    return 0;
+}
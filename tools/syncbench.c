@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * syncbench.c: thread handoff latency of the synchronized lists and threadpool
+ *****************************************************************************
+ * Copyright (C) 2026 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+
+#define RUNS 5
+
+#if HAVE_THREAD
+typedef struct
+{
+    x264_sync_frame_list_t in;
+    x264_sync_frame_list_t out;
+    int i_rounds;
+} pingpong_t;
+
+static void *pingpong_thread( pingpong_t *p )
+{
+    for( int i = 0; i < p->i_rounds; i++ )
+        x264_sync_frame_list_push( &p->out, x264_sync_frame_list_pop( &p->in ) );
+    return NULL;
+}
+
+/* One frame bounced between two threads through a pair of lists, as the lookahead does. */
+static int64_t bench_pingpong( int i_rounds )
+{
+    pingpong_t p;
+    x264_pthread_t thread;
+    x264_frame_t *frame = (x264_frame_t*)&p;
+    p.i_rounds = i_rounds;
+    if( x264_sync_frame_list_init( &p.in, 1 ) || x264_sync_frame_list_init( &p.out, 1 ) ||
+        x264_pthread_create( &thread, NULL, (void*)pingpong_thread, &p ) )
+        return -1;
+    int64_t t = x264_mdate();
+    for( int i = 0; i < i_rounds; i++ )
+    {
+        x264_sync_frame_list_push( &p.in, frame );
+        x264_sync_frame_list_pop( &p.out );
+    }
+    t = x264_mdate() - t;
+    x264_pthread_join( thread, NULL );
+    x264_sync_frame_list_delete( &p.in );
+    x264_sync_frame_list_delete( &p.out );
+    return t;
+}
+
+static void *nop_job( void *arg )
+{
+    return arg;
+}
+
+/* Fan out one trivial job per thread and wait for each in turn, as the lookahead
+ * slices and the MB-tree propagation do. */
+static int64_t bench_pool( int i_rounds, int i_threads )
+{
+    x264_threadpool_t *pool;
+    int arg[X264_LOOKAHEAD_THREAD_MAX];
+    if( x264_threadpool_init( &pool, i_threads ) )
+        return -1;
+    int64_t t = x264_mdate();
+    for( int i = 0; i < i_rounds; i++ )
+    {
+        for( int j = 0; j < i_threads; j++ )
+            x264_threadpool_run( pool, nop_job, &arg[j] );
+        for( int j = 0; j < i_threads; j++ )
+            x264_threadpool_wait( pool, &arg[j] );
+    }
+    t = x264_mdate() - t;
+    x264_threadpool_delete( pool );
+    return t;
+}
+
+static double best_of( int64_t (*func)( int, int ), int i_rounds, int i_threads )
+{
+    int64_t best = INT64_MAX;
+    for( int i = 0; i < RUNS; i++ )
+    {
+        int64_t t = func( i_rounds, i_threads );
+        if( t < 0 )
+        {
+            fprintf( stderr, "syncbench: thread creation failed\n" );
+            exit( 1 );
+        }
+        best = X264_MIN( best, t );
+    }
+    return (double)best / i_rounds;
+}
+
+static int64_t pingpong_wrap( int i_rounds, int i_threads )
+{
+    return bench_pingpong( i_rounds );
+}
+#endif
+
+int main( int argc, char **argv )
+{
+#if HAVE_THREAD
+    int i_rounds = argc > 1 ? atoi( argv[1] ) : 20000;
+    int i_threads = argc > 2 ? atoi( argv[2] ) : 4;
+    if( argc > 3 || i_rounds < 1 || i_threads < 1 || i_threads > X264_LOOKAHEAD_THREAD_MAX )
+    {
+        fprintf( stderr, "usage: syncbench [rounds [threads (1-%d)]]\n", X264_LOOKAHEAD_THREAD_MAX );
+        return 1;
+    }
+    if( x264_threading_init() < 0 )
+        return 1;
+
+    printf( "%d rounds, best of %d runs:\n", i_rounds, RUNS );
+    printf( "  list ping-pong, 2 threads   %8.2f us/round\n", best_of( pingpong_wrap, i_rounds, 1 ) );
+    for( int t = 1; t <= i_threads; t <<= 1 )
+        printf( "  threadpool fan-out, %2d jobs %8.2f us/round\n", t, best_of( bench_pool, i_rounds, t ) );
+    if( i_threads & (i_threads-1) )
+        printf( "  threadpool fan-out, %2d jobs %8.2f us/round\n", i_threads, best_of( bench_pool, i_rounds, i_threads ) );
+    return 0;
+#else
+    fprintf( stderr, "syncbench: x264 was built without threading\n" );
+    return 1;
+#endif
+}
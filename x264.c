@@ -680,6 +680,8 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "  -i, --min-keyint <integer>  Minimum GOP size [auto]\n" );
     H2( "      --no-scenecut           Disable adaptive I-frame decision\n" );
     H2( "      --scenecut <integer>    How aggressively to insert extra I-frames [%d]\n", defaults->i_scenecut_threshold );
+    H2( "      --scenecut-prefilter    Skip the cost-based scenecut check for frames whose\n"
+        "                              lowres luma layout barely changed\n" );
     H2( "      --intra-refresh         Use Periodic Intra Refresh instead of IDR frames\n" );
     H1( "  -b, --bframes <integer>     Number of B-frames between I and P [%d]\n", defaults->i_bframe );
     H1( "      --b-adapt <integer>     Adaptive B-frame decision method [%d]\n"
@@ -708,6 +710,9 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --slice-max-size <integer> Limit the size of each slice in bytes\n");
     H2( "      --slice-max-mbs <integer> Limit the size of each slice in macroblocks (max)\n");
     H2( "      --slice-min-mbs <integer> Limit the size of each slice in macroblocks (min)\n");
+    H2( "      --slice-first-rows <integer> End the first slice after this many MB rows and\n"
+        "                              later ones when they reach its size, for streaming\n"
+        "                              rows out as they are coded\n" );
     H0( "      --tff                   Enable interlaced mode (top field first)\n" );
     H0( "      --bff                   Enable interlaced mode (bottom field first)\n" );
     H2( "      --constrained-intra     Enable constrained intra prediction.\n" );
@@ -757,7 +762,16 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - 2: Last pass, does not overwrite stats file\n" );
     H2( "                                  - 3: Nth pass, overwrites stats file\n" );
     H1( "      --stats <string>        Filename for 2 pass stats [\"%s\"]\n", defaults->rc.psz_stat_out );
+    H2( "      --lookahead-out <string>  Save frame types and mb-tree offsets for reuse\n"
+        "                              by later encodes of the same source\n" );
+    H2( "      --lookahead-in <string>  Take frame types and mb-tree offsets from a\n"
+        "                              --lookahead-out file instead of running slicetype\n"
+        "                              analysis and mb-tree. Lowres frame costs are\n"
+        "                              still computed. Resolution may differ.\n" );
     H2( "      --no-mbtree             Disable mb-tree ratecontrol.\n");
+    H2( "      --mbtree-incremental    Only propagate frames new to the lookahead and what\n"
+        "                              they changed instead of the whole window.\n"
+        "                              Faster with long lookaheads, approximate.\n" );
     H2( "      --qcomp <float>         QP curve compression [%.2f]\n", defaults->rc.f_qcompress );
     H2( "      --cplxblur <float>      Reduce fluctuations in QP (before curve compression) [%.1f]\n", defaults->rc.f_complexity_blur );
     H2( "      --qblur <float>         Reduce fluctuations in QP (after curve compression) [%.1f]\n", defaults->rc.f_qblur );
@@ -797,6 +811,8 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --merange <integer>     Maximum motion vector search range [%d]\n", defaults->analyse.i_me_range );
     H2( "      --mvrange <integer>     Maximum motion vector length [-1 (auto)]\n" );
     H2( "      --mvrange-thread <int>  Minimum buffer between threads [-1 (auto)]\n" );
+    H2( "      --lookahead-hme         Seed lookahead motion search with a hierarchical\n"
+        "                              search over quarter- and eighth-res frames\n" );
     H1( "  -m, --subme <integer>       Subpixel motion estimation and mode decision [%d]\n", defaults->analyse.i_subpel_refine );
     H2( "                                  - 0: fullpel only (not recommended)\n"
         "                                  - 1: SAD mode decision, one qpel iteration\n"
@@ -823,6 +839,10 @@ static void help( x264_param_t *defaults, int longhelp )
         "                                  - 1: enabled only on the final encode of a MB\n"
         "                                  - 2: enabled on all mode decisions\n", defaults->analyse.i_trellis );
     H2( "      --no-fast-pskip         Disables early SKIP detection on P-frames\n" );
+    H2( "      --fast-decision <integer> Prune partition and intra searches using a\n"
+        "                              decision forest on cheap MB features [%d]\n"
+        "                                  - 0: disabled\n"
+        "                                  - 1-3: increasingly aggressive pruning\n", defaults->analyse.i_fast_decision );
     H2( "      --no-dct-decimate       Disables coefficient thresholding on P-frames\n" );
     H1( "      --nr <integer>          Noise reduction [%d]\n", defaults->analyse.i_noise_reduction );
     H2( "\n" );
@@ -939,11 +959,22 @@ static void help( x264_param_t *defaults, int longhelp )
     H1( "      --threads <integer>     Force a specific number of threads\n" );
     H2( "      --lookahead-threads <integer> Force a specific number of lookahead threads\n" );
     H2( "      --sliced-threads        Low-latency but lower-efficiency threading\n" );
+    H2( "      --sliced-threads-balance Move the slice boundaries each frame to even\n"
+        "                                  out the threads' work\n" );
     H2( "      --thread-input          Run Avisynth in its own thread\n" );
     H2( "      --sync-lookahead <integer> Number of buffer frames for threaded lookahead\n" );
     H2( "      --non-deterministic     Slightly improve quality of SMP, at the cost of repeatability\n" );
     H2( "      --cpu-independent       Ensure exact reproducibility across different cpus,\n"
         "                                  as opposed to letting them select different algorithms\n" );
+    H2( "      --frame-prealloc        Allocate all frame buffers at startup and fault them in,\n"
+        "                                  so that the encode itself never allocates frames\n" );
+    H2( "      --cpu-autotune          Benchmark the optimized kernels at startup and use\n"
+        "                                  the fastest ones. Does not change the output.\n" );
+    H2( "      --cpu-autotune-cache <string> Load/save the --cpu-autotune choices (implies it)\n" );
+    H2( "      --speed <float>         Lower the analysis settings per frame as needed to\n"
+        "                                  encode at this multiple of the framerate [0 = off]\n" );
+    H2( "      --speed-bufsize <integer> Frames of encoding time that can be borrowed\n"
+        "                                  to absorb slow frames [%d]\n", defaults->sc.i_buffer_size );
     H2( "      --asm <integer>         Override CPU detection\n" );
     H2( "      --no-asm                Disable all CPU optimizations\n" );
     H2( "      --opencl                Enable use of OpenCL\n" );
@@ -1034,6 +1065,7 @@ static struct option long_options[] =
     { "intra-refresh",        no_argument,       NULL, 0 },
     { "scenecut",             required_argument, NULL, 0 },
     { "no-scenecut",          no_argument,       NULL, 0 },
+    { "scenecut-prefilter",   no_argument,       NULL, 0 },
     { "nf",                   no_argument,       NULL, 0 },
     { "no-deblock",           no_argument,       NULL, 0 },
     { "filter",               required_argument, NULL, 0 },
@@ -1077,6 +1109,7 @@ static struct option long_options[] =
     { "merange",              required_argument, NULL, 0 },
     { "mvrange",              required_argument, NULL, 0 },
     { "mvrange-thread",       required_argument, NULL, 0 },
+    { "lookahead-hme",        no_argument,       NULL, 0 },
     { "subme",                required_argument, NULL, 'm' },
     { "psy-rd",               required_argument, NULL, 0 },
     { "no-psy",               no_argument,       NULL, 0 },
@@ -1089,6 +1122,7 @@ static struct option long_options[] =
     { "trellis",              required_argument, NULL, 't' },
     { "fast-pskip",           no_argument,       NULL, 0 },
     { "no-fast-pskip",        no_argument,       NULL, 0 },
+    { "fast-decision",        required_argument, NULL, 0 },
     { "no-dct-decimate",      no_argument,       NULL, 0 },
     { "aq-strength",          required_argument, NULL, 0 },
     { "aq-mode",              required_argument, NULL, 0 },
@@ -1105,9 +1139,12 @@ static struct option long_options[] =
     { "chroma-qp-offset",     required_argument, NULL, 0 },
     { "pass",                 required_argument, NULL, 'p' },
     { "stats",                required_argument, NULL, 0 },
+    { "lookahead-out",        required_argument, NULL, 0 },
+    { "lookahead-in",         required_argument, NULL, 0 },
     { "qcomp",                required_argument, NULL, 0 },
     { "mbtree",               no_argument,       NULL, 0 },
     { "no-mbtree",            no_argument,       NULL, 0 },
+    { "mbtree-incremental",   no_argument,       NULL, 0 },
     { "qblur",                required_argument, NULL, 0 },
     { "cplxblur",             required_argument, NULL, 0 },
     { "zones",                required_argument, NULL, 0 },
@@ -1116,15 +1153,22 @@ static struct option long_options[] =
     { "lookahead-threads",    required_argument, NULL, 0 },
     { "sliced-threads",       no_argument,       NULL, 0 },
     { "no-sliced-threads",    no_argument,       NULL, 0 },
+    { "sliced-threads-balance", no_argument,     NULL, 0 },
     { "slice-max-size",       required_argument, NULL, 0 },
     { "slice-max-mbs",        required_argument, NULL, 0 },
     { "slice-min-mbs",        required_argument, NULL, 0 },
+    { "slice-first-rows",     required_argument, NULL, 0 },
     { "slices",               required_argument, NULL, 0 },
     { "slices-max",           required_argument, NULL, 0 },
     { "thread-input",         no_argument,       NULL, OPT_THREAD_INPUT },
     { "sync-lookahead",       required_argument, NULL, 0 },
     { "non-deterministic",    no_argument,       NULL, 0 },
     { "cpu-independent",      no_argument,       NULL, 0 },
+    { "frame-prealloc",       no_argument,       NULL, 0 },
+    { "cpu-autotune",         no_argument,       NULL, 0 },
+    { "cpu-autotune-cache",   required_argument, NULL, 0 },
+    { "speed",                required_argument, NULL, 0 },
+    { "speed-bufsize",        required_argument, NULL, 0 },
     { "psnr",                 no_argument,       NULL, 0 },
     { "ssim",                 no_argument,       NULL, 0 },
     { "quiet",                no_argument,       NULL, OPT_QUIET },
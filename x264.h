@@ -45,7 +45,7 @@ extern "C" {
 
 #include "x264_config.h"
 
-#define X264_BUILD 164
+#define X264_BUILD 179
 
 #ifdef _WIN32
 #   define X264_DLL_IMPORT __declspec(dllimport)
@@ -308,9 +308,15 @@ typedef struct x264_param_t
     int         i_threads;           /* encode multiple frames in parallel */
     int         i_lookahead_threads; /* multiple threads for lookahead analysis */
     int         b_sliced_threads;  /* Whether to use slice-based threading. */
+    int         b_sliced_threads_balance; /* With sliced threads, move the slice boundaries each frame to
+                                           * even out the rows' cost in the previous frame of the same type. */
     int         b_deterministic; /* whether to allow non-deterministic optimizations when threaded */
     int         b_cpu_independent; /* force canonical behavior rather than cpu-dependent optimal algorithms */
+    int         b_cpu_autotune;    /* benchmark the kernels allowed by cpu at startup and use the fastest */
+    char        *psz_cpu_autotune_cache; /* if set, filename (in UTF-8) to load/save the autotune result. Implies b_cpu_autotune */
     int         i_sync_lookahead; /* threaded lookahead buffer */
+    int         b_frame_prealloc; /* allocate every frame the encode can need in x264_encoder_open and fault
+                                   * its pages in, instead of growing the frame pool during the encode */
 
     /* Video Properties */
     int         i_width;
@@ -352,6 +358,7 @@ typedef struct x264_param_t
     int         i_keyint_max;       /* Force an IDR keyframe at this interval */
     int         i_keyint_min;       /* Scenecuts closer together than this are coded as I, not IDR. */
     int         i_scenecut_threshold; /* how aggressively to insert extra I frames */
+    int         b_scenecut_prefilter; /* rule out obvious non-scenecuts from lowres luma statistics before the cost-based check */
     int         b_intra_refresh;    /* Whether or not to use periodic intra refresh instead of IDR frames. */
 
     int         i_bframe;   /* how many b-frame between 2 references pictures */
@@ -407,11 +414,13 @@ typedef struct x264_param_t
         int          i_me_range; /* integer pixel motion estimation search range (from predicted mv) */
         int          i_mv_range; /* maximum length of a mv (in pixels). -1 = auto, based on level */
         int          i_mv_range_thread; /* minimum space between threads. -1 = auto, based on number of threads. */
+        int          b_lookahead_hme; /* hierarchical motion search over quarter/eighth-res planes in the lookahead */
         int          i_subpel_refine; /* subpixel motion estimation quality */
         int          b_chroma_me; /* chroma ME for subpel and mode decision in P-frames */
         int          b_mixed_references; /* allow each mb partition to have its own reference number */
         int          i_trellis;  /* trellis RD quantization */
         int          b_fast_pskip; /* early SKIP detection on P-frames */
+        int          i_fast_decision; /* prune partition and intra searches using a decision forest: 0=off, 1-3=aggressiveness */
         int          b_dct_decimate; /* transform coefficient thresholding on P-frames */
         int          i_noise_reduction; /* adaptive pseudo-deadzone */
         float        f_psy_rd; /* Psy RD strength */
@@ -455,6 +464,7 @@ typedef struct x264_param_t
         int         i_aq_mode;      /* psy adaptive QP. (X264_AQ_*) */
         float       f_aq_strength;
         int         b_mb_tree;      /* Macroblock-tree ratecontrol. */
+        int         b_mb_tree_incremental; /* Only propagate what changed since the last lookahead call (approximate). */
         int         i_lookahead;
 
         /* 2pass */
@@ -463,6 +473,12 @@ typedef struct x264_param_t
         int         b_stat_read;    /* Read stat from psz_stat_in and use it */
         char        *psz_stat_in;   /* input filename (in UTF-8) of the 2pass stats file */
 
+        /* Lookahead analysis file: frame types and MB-tree offsets, reusable across encodes of the same source.
+         * Lowres costs and motion vectors are not stored: reading a file skips slicetype analysis and
+         * MB-tree propagation, but the lowres frame costs used by ratecontrol are still computed. */
+        char        *psz_lookahead_out; /* if set, filename (in UTF-8) to write the lookahead results to */
+        char        *psz_lookahead_in;  /* if set, filename (in UTF-8) to read them from instead of analysing */
+
         /* 2pass params (same as ffmpeg ones) */
         float       f_qcompress;    /* 0.0 => cbr, 1.0 => constant qp */
         float       f_qblur;        /* temporally blur quants */
@@ -472,6 +488,16 @@ typedef struct x264_param_t
         char        *psz_zones;     /* alternate method of specifying zones */
     } rc;
 
+    /* Speed control: lower the analysis settings (subme, me, refs, partitions, trellis)
+     * per frame when encoding falls behind the target speed, and raise them again when
+     * it catches up.  The settings given at open or by x264_encoder_reconfig are the
+     * slowest ones used.  Makes the output depend on timing. */
+    struct
+    {
+        float       f_speed;        /* target speed as a multiple of the framerate; 0 = disabled */
+        int         i_buffer_size;  /* frames of encoding time that can be borrowed to absorb spikes */
+    } sc;
+
     /* Cropping Rectangle parameters: added to those implicitly defined by
        non-mod16 video resolutions. */
     struct
@@ -566,6 +592,10 @@ typedef struct x264_param_t
     int i_slice_count;       /* Number of slices per frame: forces rectangular slices. */
     int i_slice_count_max;   /* Absolute cap on slices per frame; stops applying slice-max-size
                               * and slice-max-mbs if this is reached. */
+    int i_slice_first_rows;  /* Low-latency slicing for nalu_process: end the first slice (of each
+                              * thread with sliced threads) after this many MB rows, and each later
+                              * one on the first row where it gets as big as the first.
+                              * Overrides i_slice_max_mbs and i_slice_count. */
 
     /* Optional callback for freeing this x264_param_t when it is done being used.
      * Only used when the x264_param_t sits in memory for an indefinite period of time,
@@ -600,8 +630,8 @@ typedef struct x264_param_t
      * When this callback is enabled, x264_encoder_encode does not return valid NALs;
      * the calling application is expected to acquire all output NALs through the callback.
      *
-     * It is generally sensible to combine this callback with a use of slice-max-mbs or
-     * slice-max-size.
+     * It is generally sensible to combine this callback with a use of slice-max-mbs,
+     * slice-max-size or slice-first-rows.
      *
      * The opaque pointer is the opaque pointer from the input frame associated with this
      * NAL unit. This helps distinguish between nalu_process calls from different sources,
@@ -609,6 +639,22 @@ typedef struct x264_param_t
      */
     void (*nalu_process)( x264_t *h, x264_nal_t *nal, void *opaque );
 
+    /* Optional output buffer provider: if set, x264_encoder_encode and x264_encoder_headers
+     * write the encapsulated NAL units straight into a buffer obtained from this callback
+     * instead of into an internal buffer, and the returned x264_nal_t payloads point into it.
+     * This lets applications encapsulate directly into e.g. pooled packet buffers.
+     *
+     * i_size is the worst-case size of the NAL units about to be written; the callback must
+     * return a buffer of at least that size, or NULL to make the call fail.  The buffer is not
+     * touched again by x264 once the call that requested it returns, so ownership goes back to
+     * the application along with the NALs; the number of bytes actually used is the return
+     * value of that call.  CBR filler NAL units are written after ratecontrol and get a buffer
+     * of their own, so with filler the payloads are only sequential within each buffer.
+     *
+     * opaque is the opaque pointer of the picture being output, or NULL for headers.
+     * Ignored if nalu_process is set.  Not supported in AVC-Intra mode. */
+    uint8_t *(*nal_buffer_get)( x264_t *h, int i_size, void *opaque );
+
     /* For internal use only */
     void *opaque;
 } x264_param_t;
@@ -797,6 +843,55 @@ typedef struct x264_image_t
     uint8_t *plane[4];   /* Pointers to each plane */
 } x264_image_t;
 
+/* Per-macroblock analysis hints, e.g. taken from the decoder of the source stream or
+ * from a previous encode of the same content.  They seed and prune x264's own analysis;
+ * x264 still makes the final decisions, so poor hints cost speed or quality, not validity. */
+typedef struct x264_mb_hint_t
+{
+    /* Candidate motion vector for each list in quarter-pel units, and the reference index
+     * into x264's list for the current frame that it points to (-1 if the list has no
+     * candidate).  Candidates for unused lists or out-of-range references are ignored. */
+    int16_t mv[2][2];
+    int8_t  i_ref[2];
+    /* Suggested macroblock type/partition, X264_MBHINT_*. */
+    uint8_t i_partition;
+    /* Suggested Intra16x16PredMode (0=V, 1=H, 2=DC, 3=Plane), -1 if none.  Only read when
+     * i_partition is X264_MBHINT_I16x16, so it can be left at 0 for other hints. */
+    int8_t  i_intra_mode;
+} x264_mb_hint_t;
+
+#define X264_MBHINT_NONE    0
+#define X264_MBHINT_SKIP    1
+#define X264_MBHINT_16x16   2
+#define X264_MBHINT_16x8    3
+#define X264_MBHINT_8x16    4
+#define X264_MBHINT_8x8     5
+#define X264_MBHINT_I16x16  6
+#define X264_MBHINT_I8x8    7
+#define X264_MBHINT_I4x4    8
+
+/* Per-macroblock results of encoding a frame.  The partition, intra mode, references and
+ * vectors use the same conventions as x264_mb_hint_t, so they can be turned into hints
+ * for another encode of the same content. */
+typedef struct x264_mb_export_t
+{
+    /* Coded type/partition, X264_MBHINT_*.  B_DIRECT macroblocks are reported as 16x16
+     * with their derived vectors, PCM macroblocks as X264_MBHINT_I16x16. */
+    uint8_t  i_partition;
+    /* Intra16x16PredMode for X264_MBHINT_I16x16, -1 otherwise. */
+    int8_t   i_intra_mode;
+    /* QP the macroblock was coded with. */
+    uint8_t  i_qp;
+    /* Reference index (-1 if the list is unused) and quarter-pel motion vector per list for
+     * each 8x8 block in raster order.  Sub-8x8 partitions report their top-left vector. */
+    int8_t   i_ref[2][4];
+    int16_t  mv[2][4][2];
+    /* Luma SATD between the source and the undeblocked reconstruction. */
+    uint32_t i_satd;
+    /* Bits spent coding the macroblock.  CAVLC skip runs are not attributed to any macroblock. */
+    uint32_t i_bits;
+} x264_mb_export_t;
+
 typedef struct x264_image_properties_t
 {
     /* All arrays of data here are ordered as follows:
@@ -842,6 +937,19 @@ typedef struct x264_image_properties_t
     #define X264_MBINFO_CONSTANT   (1U<<0)
     /* More flags may be added in the future. */
 
+    /* In: optional array of analysis hints for each macroblock, see x264_mb_hint_t.
+     *     Motion vector candidates are added to the 16x16 motion search and the suggested
+     *     partition prunes partition and intra searches.  Hints are ignored in MBAFF.
+     *     x264_param_t.analyse.b_mb_info must be set to use this. */
+    x264_mb_hint_t *mb_hints;
+    /* In: optional callback to free mb_hints when used. */
+    void (*mb_hints_free)( void* );
+
+    /* In: optional caller-owned array of x264_mb_export_t, one per macroblock, which x264
+     *     fills while encoding this picture.  It must stay valid until the picture is output.
+     * Out: the same array, complete, on the output picture (NULL if none was given). */
+    x264_mb_export_t *mb_export;
+
     /* Out: SSIM of the the frame luma (if x264_param_t.b_ssim is set) */
     double f_ssim;
     /* Out: Average PSNR of the frame (if x264_param_t.b_psnr is set) */
@@ -961,7 +1069,8 @@ X264_API int x264_encoder_headers( x264_t *, x264_nal_t **pp_nal, int *pi_nal );
  *      *pi_nal is the number of NAL units outputted in pp_nal.
  *      returns the number of bytes in the returned NALs.
  *      returns negative on error and zero if no NAL units returned.
- *      the payloads of all output NALs are guaranteed to be sequential in memory. */
+ *      the payloads of all output NALs are guaranteed to be sequential in memory
+ *      (see nal_buffer_get for the one exception). */
 X264_API int x264_encoder_encode( x264_t *, x264_nal_t **pp_nal, int *pi_nal, x264_picture_t *pic_in, x264_picture_t *pic_out );
 /* x264_encoder_close:
  *      close an encoder handler */
@@ -1011,6 +1120,40 @@ X264_API void x264_encoder_intra_refresh( x264_t * );
  *
  *      Returns 0 on success, negative on failure. */
 X264_API int x264_encoder_invalidate_reference( x264_t *, int64_t pts );
+/* x264_encoder_reset:
+ *      Returns an open encoder to the state x264_encoder_open leaves it in, so that it can be reused
+ *      for a new, independent sequence without the cost of closing and reopening it.  The next frame
+ *      encoded will be an IDR frame with frame_num and POC starting over, ratecontrol state is
+ *      discarded, and timestamps may start over.  Headers do not need to be resent unless param
+ *      changes them.
+ *
+ *      If param is non-NULL, any of the parameters supported by x264_encoder_reconfig may be changed,
+ *      as well as the ratecontrol targets (bitrate, qp, ratetol and vbv-init).
+ *
+ *      All delayed frames must have been flushed out (x264_encoder_delayed_frames returns 0) before
+ *      calling this.  Not supported with multi-pass encoding or lookahead files.
+ *
+ *      Should not be called during an x264_encoder_encode.
+ *
+ *      Returns 0 on success, negative on failure. */
+X264_API int x264_encoder_reset( x264_t *, x264_param_t * );
+
+typedef struct x264_frame_pool_stats_t
+{
+    int     i_input_frames;         /* input frames allocated so far */
+    int     i_recon_frames;         /* reconstructed frames allocated so far */
+    int     i_input_frames_open;    /* of which allocated by x264_encoder_open */
+    int     i_recon_frames_open;
+    int64_t i_bytes;                /* total size of the frames allocated so far */
+} x264_frame_pool_stats_t;
+
+/* x264_encoder_frame_pool_stats:
+ *      fills *stats with the frames the encoder has allocated.  Frames are never freed before
+ *      x264_encoder_close, so the counts only grow; with b_frame_prealloc they should stay at
+ *      the _open values.
+ *
+ *      Should not be called during an x264_encoder_encode. */
+X264_API void x264_encoder_frame_pool_stats( x264_t *, x264_frame_pool_stats_t *stats );
 
 #ifdef __cplusplus
 }